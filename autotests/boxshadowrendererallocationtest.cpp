@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// own
+#include "breezeboxshadowrenderer.h"
+#include "breezeshadowparams.h"
+
+// Qt
+#include <QPainter>
+#include <QStandardPaths>
+#include <QTest>
+
+// std
+#include <cstddef>
+
+using namespace Breeze;
+
+namespace
+{
+
+// Decoration settings, same as in boxshadowrenderertest.
+const int s_smallSpacing = 2;
+const int s_cornerRadius = 0;
+
+const char *const s_presetNames[] = {"none", "small", "medium", "large", "verylarge"};
+
+// Only allocations of the thread that runs the tests are counted, and only
+// while an AllocationCounter is alive.
+thread_local bool s_counting = false;
+thread_local int s_allocations = 0;
+
+qreal borderRadius()
+{
+    // same as the decoration
+    return 0.5 * s_smallSpacing * (s_cornerRadius + 0.5);
+}
+
+/**
+ * Counts the calls to malloc, calloc and realloc during its lifetime.
+ *
+ * QImage, QArrayData and QHash allocate with malloc directly, and so does
+ * operator new underneath, so this catches all of them.
+ **/
+class AllocationCounter
+{
+public:
+    AllocationCounter()
+    {
+        s_allocations = 0;
+        s_counting = true;
+    }
+
+    ~AllocationCounter()
+    {
+        s_counting = false;
+    }
+
+    int count() const
+    {
+        return s_allocations;
+    }
+};
+
+} // anonymous namespace
+
+#if defined(__GLIBC__)
+
+// glibc exports its allocator under these names too, so the definitions below
+// replace malloc and friends for the whole process, Qt included, and forward.
+extern "C" {
+
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(std::size_t size) noexcept
+{
+    if (s_counting) {
+        ++s_allocations;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size) noexcept
+{
+    if (s_counting) {
+        ++s_allocations;
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size) noexcept
+{
+    if (s_counting) {
+        ++s_allocations;
+    }
+    return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer) noexcept
+{
+    __libc_free(pointer);
+}
+
+} // extern "C"
+
+#endif
+
+/**
+ * Memory BoxShadowRenderer allocates once the masks of a shadow are cached.
+ **/
+class BoxShadowRendererAllocationTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testRenderMasks_data();
+    void testRenderMasks();
+
+    void testRender_data();
+    void testRender();
+
+private:
+    void addPresets();
+};
+
+void BoxShadowRendererAllocationTest::initTestCase()
+{
+#if !defined(__GLIBC__)
+    QSKIP("counting allocations needs glibc");
+#endif
+
+    // keep the masks BoxShadowRenderer persists out of the user's cache
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void BoxShadowRendererAllocationTest::addPresets()
+{
+    QTest::addColumn<int>("preset");
+    QTest::addColumn<qreal>("dpr");
+
+    for (int preset = 1; preset < s_shadowParamsCount; ++preset) {
+        for (qreal dpr : {1.0, 2.0}) {
+            QTest::newRow(qPrintable(QStringLiteral("%1 dpr %2").arg(QLatin1String(s_presetNames[preset])).arg(dpr)))
+                << preset << dpr;
+        }
+    }
+}
+
+void BoxShadowRendererAllocationTest::testRenderMasks_data()
+{
+    addPresets();
+}
+
+void BoxShadowRendererAllocationTest::testRenderMasks()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    const QSize boxSize = params.boxSize(borderRadius());
+    const int radii[] = {params.shadow1.radius, params.shadow2.radius};
+
+    QImage masks[2];
+    BoxShadowRenderer::renderMasks(boxSize, borderRadius(), radii, 2, dpr, BoxShadowRenderer::Method::Automatic, masks);
+
+    // cached masks are shared, not copied
+    AllocationCounter counter;
+    BoxShadowRenderer::renderMasks(boxSize, borderRadius(), radii, 2, dpr, BoxShadowRenderer::Method::Automatic, masks);
+    QCOMPARE(counter.count(), 0);
+}
+
+void BoxShadowRendererAllocationTest::testRender_data()
+{
+    addPresets();
+}
+
+void BoxShadowRendererAllocationTest::testRender()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+
+    BoxShadowRenderer renderer;
+    renderer.setBoxSize(params.boxSize(borderRadius()));
+    renderer.setBorderRadius(borderRadius());
+    renderer.setDevicePixelRatio(dpr);
+    renderer.setMethod(BoxShadowRenderer::Method::Automatic);
+    renderer.addShadow(params.shadow1.offset, params.shadow1.radius, QColor(0, 0, 0, 200));
+    renderer.addShadow(params.shadow2.offset, params.shadow2.radius, QColor(0, 0, 0, 100));
+
+    // fills the mask cache and the scratch buffers
+    const QSize size = renderer.render().size();
+
+    int imageAllocations = 0;
+    {
+        AllocationCounter counter;
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+        imageAllocations = counter.count();
+    }
+
+    // make sure the counter sees what Qt allocates
+    QVERIFY(imageAllocations > 0);
+
+    // nothing but the returned image
+    QImage texture;
+    {
+        AllocationCounter counter;
+        texture = renderer.render();
+        QCOMPARE(counter.count(), imageAllocations);
+    }
+
+    // the texture isn't shared, so painting on it doesn't copy it
+    QVERIFY(texture.isDetached());
+    const uchar *bits = texture.constBits();
+    QPainter painter(&texture);
+    painter.fillRect(QRect(0, 0, 1, 1), Qt::black);
+    painter.end();
+    QVERIFY(texture.constBits() == bits);
+}
+
+QTEST_GUILESS_MAIN(BoxShadowRendererAllocationTest)
+
+#include "boxshadowrendererallocationtest.moc"
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// own
+#include "breezeboxshadowrenderer.h"
+#include "breezeshadowmask.h"
+#include "breezeshadowparams.h"
+
+// Qt
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QTest>
+#include <QtMath>
+
+using namespace Breeze;
+
+Q_DECLARE_METATYPE(Breeze::BoxShadowRenderer::Method)
+Q_DECLARE_METATYPE(Breeze::ShadowMask::VerticalPass)
+
+namespace
+{
+
+// Decoration settings, same as in boxshadowrenderertest.
+const int s_smallSpacing = 2;
+const int s_cornerRadius = 0;
+
+const char *const s_presetNames[] = {"none", "small", "medium", "large", "verylarge"};
+
+qreal borderRadius()
+{
+    // same as the decoration
+    return 0.5 * s_smallSpacing * (s_cornerRadius + 0.5);
+}
+
+/**
+ * Run a function in a QBENCHMARK loop and report its throughput.
+ *
+ * @param pixels The number of pixels one call processes.
+ * @param bytesPerPixel The size of these pixels.
+ * @param function The function to measure.
+ **/
+template<typename Function>
+void measure(qint64 pixels, int bytesPerPixel, const Function &function)
+{
+    QElapsedTimer timer;
+    qint64 nsecs = 0;
+    qint64 iterations = 0;
+
+    QBENCHMARK {
+        timer.start();
+        function();
+        nsecs += timer.nsecsElapsed();
+        ++iterations;
+    }
+
+    const qreal nsecsPerCall = qMax<qreal>(1, qreal(nsecs) / qMax<qint64>(1, iterations));
+    qInfo().noquote() << QStringLiteral("%1 px, %2 ns/px, %3 MB/s")
+        .arg(pixels)
+        .arg(nsecsPerCall / pixels, 0, 'f', 3)
+        .arg(pixels * bytesPerPixel * 1000.0 / nsecsPerCall, 0, 'f', 1);
+}
+
+} // anonymous namespace
+
+/**
+ * Throughput of the stages of rendering decoration shadows.
+ *
+ * Every shadow size preset is measured at the device pixel ratios that are
+ * common on real outputs. Besides the time per call, each function reports
+ * the nanoseconds per pixel and megabytes per second it achieved.
+ **/
+class BoxShadowRendererBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchmarkRender_data();
+    void benchmarkRender();
+
+    void benchmarkGenerateMask_data();
+    void benchmarkGenerateMask();
+
+    void benchmarkGenerateMasks_data();
+    void benchmarkGenerateMasks();
+
+    void benchmarkBoxBlur_data();
+    void benchmarkBoxBlur();
+
+    void benchmarkMirror_data();
+    void benchmarkMirror();
+
+private:
+    void addPresets();
+};
+
+void BoxShadowRendererBenchmark::initTestCase()
+{
+    // keep the masks BoxShadowRenderer persists out of the user's cache
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void BoxShadowRendererBenchmark::addPresets()
+{
+    QTest::addColumn<int>("preset");
+    QTest::addColumn<qreal>("dpr");
+
+    for (int preset = 1; preset < s_shadowParamsCount; ++preset) {
+        for (qreal dpr : {1.0, 1.5, 2.0}) {
+            QTest::newRow(qPrintable(QStringLiteral("%1 dpr %2").arg(QLatin1String(s_presetNames[preset])).arg(dpr)))
+                << preset << dpr;
+        }
+    }
+}
+
+void BoxShadowRendererBenchmark::benchmarkRender_data()
+{
+    addPresets();
+}
+
+void BoxShadowRendererBenchmark::benchmarkRender()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+
+    BoxShadowRenderer renderer;
+    renderer.setBoxSize(params.boxSize(borderRadius()));
+    renderer.setBorderRadius(borderRadius());
+    renderer.setDevicePixelRatio(dpr);
+
+    QColor color1(Qt::black);
+    color1.setAlphaF(params.shadow1.opacity);
+    renderer.addShadow(params.shadow1.offset, params.shadow1.radius, color1);
+
+    QColor color2(Qt::black);
+    color2.setAlphaF(params.shadow2.opacity);
+    renderer.addShadow(params.shadow2.offset, params.shadow2.radius, color2);
+
+    // Masks are cached after the first call, what is left is giving them their
+    // color, which is all a decoration pays once the first one has been mapped.
+    const QImage texture = renderer.render();
+    const qint64 pixels = qint64(texture.width()) * texture.height();
+
+    measure(pixels, 4, [&renderer]() {
+        renderer.render();
+    });
+}
+
+void BoxShadowRendererBenchmark::benchmarkGenerateMask_data()
+{
+    addPresets();
+}
+
+void BoxShadowRendererBenchmark::benchmarkGenerateMask()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+
+    // what a mask that is neither cached in memory nor on disk costs
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    const QSize boxSize = params.boxSize(borderRadius());
+
+    const QImage mask = ShadowMask::generate(boxSize, borderRadius(), params.shadow1.radius, dpr,
+                                             BoxShadowRenderer::Method::BoxBlur);
+    const qint64 pixels = qint64(mask.width()) * mask.height();
+
+    measure(pixels, 1, [&]() {
+        ShadowMask::generate(boxSize, borderRadius(), params.shadow1.radius, dpr, BoxShadowRenderer::Method::BoxBlur);
+    });
+}
+
+void BoxShadowRendererBenchmark::benchmarkGenerateMasks_data()
+{
+    QTest::addColumn<int>("preset");
+    QTest::addColumn<qreal>("dpr");
+    QTest::addColumn<BoxShadowRenderer::Method>("method");
+    QTest::addColumn<bool>("shared");
+
+    // Both masks of a shadow, each rendered on its own or the larger one continued
+    // from the smaller one, as BoxShadowRenderer::renderMasks does. Both run on the
+    // calling thread, so this compares the work and not how it spreads over threads.
+    const BoxShadowRenderer::Method methods[] = {
+        BoxShadowRenderer::Method::BoxBlur,
+        BoxShadowRenderer::Method::Recursive
+    };
+
+    for (int preset = 1; preset < s_shadowParamsCount; ++preset) {
+        for (qreal dpr : {1.0, 1.5, 2.0}) {
+            for (BoxShadowRenderer::Method method : methods) {
+                const QString name = QStringLiteral("%1 dpr %2 %3").arg(QLatin1String(s_presetNames[preset])).arg(dpr)
+                    .arg(method == BoxShadowRenderer::Method::BoxBlur ? QStringLiteral("boxblur") : QStringLiteral("recursive"));
+                QTest::newRow(qPrintable(name + QStringLiteral(" independent"))) << preset << dpr << method << false;
+                QTest::newRow(qPrintable(name + QStringLiteral(" shared"))) << preset << dpr << method << true;
+            }
+        }
+    }
+}
+
+void BoxShadowRendererBenchmark::benchmarkGenerateMasks()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+    QFETCH(BoxShadowRenderer::Method, method);
+    QFETCH(bool, shared);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    const QSize boxSize = params.boxSize(borderRadius());
+    const int sourceRadius = params.shadow2.radius;
+    const int radius = params.shadow1.radius;
+
+    const QImage source = ShadowMask::generate(boxSize, borderRadius(), sourceRadius, dpr, BoxShadowRenderer::Method::BoxBlur);
+    if (shared && ShadowMask::generateFrom(source, sourceRadius, boxSize, borderRadius(), radius, dpr, method).isNull()) {
+        QSKIP("the masks don't line up on whole device pixels");
+    }
+
+    const QImage mask = ShadowMask::generate(boxSize, borderRadius(), radius, dpr, method);
+    const qint64 pixels = qint64(source.width()) * source.height() + qint64(mask.width()) * mask.height();
+
+    measure(pixels, 1, [&]() {
+        const QImage smaller = ShadowMask::generate(boxSize, borderRadius(), sourceRadius, dpr,
+                                                    BoxShadowRenderer::Method::BoxBlur);
+        if (shared) {
+            ShadowMask::generateFrom(smaller, sourceRadius, boxSize, borderRadius(), radius, dpr, method);
+        } else {
+            ShadowMask::generate(boxSize, borderRadius(), radius, dpr, method);
+        }
+    });
+}
+
+void BoxShadowRendererBenchmark::benchmarkBoxBlur_data()
+{
+    QTest::addColumn<int>("preset");
+    QTest::addColumn<qreal>("dpr");
+    QTest::addColumn<ShadowMask::VerticalPass>("verticalPass");
+
+    // The vertical pass blurs the columns of the mask in place, a tiled pass that
+    // packs strips of columns first is measured along with it.
+    for (int preset = 1; preset < s_shadowParamsCount; ++preset) {
+        for (qreal dpr : {1.0, 1.5, 2.0}) {
+            const QString name = QStringLiteral("%1 dpr %2").arg(QLatin1String(s_presetNames[preset])).arg(dpr);
+            QTest::newRow(qPrintable(name + QStringLiteral(" direct"))) << preset << dpr << ShadowMask::VerticalPass::Direct;
+            QTest::newRow(qPrintable(name + QStringLiteral(" tiled"))) << preset << dpr << ShadowMask::VerticalPass::Tiled;
+        }
+    }
+}
+
+void BoxShadowRendererBenchmark::benchmarkBoxBlur()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+    QFETCH(ShadowMask::VerticalPass, verticalPass);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    QImage mask = ShadowMask::generate(params.boxSize(borderRadius()), borderRadius(), params.shadow1.radius, dpr,
+                                       BoxShadowRenderer::Method::BoxBlur);
+
+    // the most the pipeline ever blurs is the top-left quadrant
+    const QRect quadrant(0, 0, qCeil(mask.width() * 0.5), qCeil(mask.height() * 0.5));
+    const int radius = qRound(params.shadow1.radius * dpr);
+
+    measure(qint64(quadrant.width()) * quadrant.height(), 1, [&]() {
+        ShadowMask::boxBlur(mask, radius, quadrant, verticalPass);
+    });
+}
+
+void BoxShadowRendererBenchmark::benchmarkMirror_data()
+{
+    addPresets();
+}
+
+void BoxShadowRendererBenchmark::benchmarkMirror()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    QImage mask = ShadowMask::generate(params.boxSize(borderRadius()), borderRadius(), params.shadow1.radius, dpr,
+                                       BoxShadowRenderer::Method::BoxBlur);
+
+    measure(qint64(mask.width()) * mask.height(), 1, [&]() {
+        ShadowMask::mirrorTopLeftQuadrant(mask);
+    });
+}
+
+QTEST_GUILESS_MAIN(BoxShadowRendererBenchmark)
+
+#include "boxshadowrendererbenchmark.moc"
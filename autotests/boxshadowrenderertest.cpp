@@ -0,0 +1,683 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// own
+#include "breezeboxshadowrenderer.h"
+#include "breezeshadowmask.h"
+#include "breezeshadowparams.h"
+
+// Qt
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QTest>
+#include <QtMath>
+
+// std
+#include <array>
+#include <utility>
+#include <vector>
+
+using namespace Breeze;
+
+Q_DECLARE_METATYPE(Breeze::BoxShadowRenderer::Method)
+Q_DECLARE_METATYPE(Breeze::ShadowMask::VerticalPass)
+
+namespace
+{
+
+// Decoration settings the golden masks are rendered with, keep in sync with generatemasks.py.
+const int s_smallSpacing = 2;
+const int s_cornerRadius = 0;
+
+// Names of the presets in the file names of the golden masks, in the order of s_shadowParams.
+const char *const s_presetNames[] = {"none", "small", "medium", "large", "verylarge"};
+
+// The antialiasing of the box may be a level off between Qt versions, and so may
+// the floating point math of the analytic and recursive methods between compilers.
+const int s_goldenTolerance = 1;
+
+qreal borderRadius()
+{
+    // same as the decoration
+    return 0.5 * s_smallSpacing * (s_cornerRadius + 0.5);
+}
+
+QString methodName(BoxShadowRenderer::Method method)
+{
+    switch (method) {
+    case BoxShadowRenderer::Method::BoxBlur:
+        return QStringLiteral("boxblur");
+    case BoxShadowRenderer::Method::Analytic:
+        return QStringLiteral("analytic");
+    case BoxShadowRenderer::Method::Recursive:
+        return QStringLiteral("recursive");
+    case BoxShadowRenderer::Method::Automatic:
+        return QStringLiteral("automatic");
+    }
+    return {};
+}
+
+QImage randomImage(const QSize &size, QImage::Format format, quint32 seed)
+{
+    QImage image(size, format);
+    QRandomGenerator random(seed);
+    for (int y = 0; y < image.height(); ++y) {
+        uchar *line = image.scanLine(y);
+        for (int x = 0; x < image.bytesPerLine(); ++x) {
+            line[x] = static_cast<uchar>(random.bounded(256));
+        }
+    }
+    return image;
+}
+
+int alpha(const QImage &image, int x, int y)
+{
+    if (image.format() == QImage::Format_Alpha8) {
+        return image.constScanLine(y)[x];
+    }
+    return qAlpha(reinterpret_cast<const QRgb *>(image.constScanLine(y))[x]);
+}
+
+void setAlpha(QImage &image, int x, int y, int value)
+{
+    if (image.format() == QImage::Format_Alpha8) {
+        image.scanLine(y)[x] = static_cast<uchar>(value);
+        return;
+    }
+    QRgb &pixel = reinterpret_cast<QRgb *>(image.scanLine(y))[x];
+    pixel = (pixel & 0x00ffffff) | (uint(value) << 24);
+}
+
+//* lobes of the three box filters of a blur radius, written out independently of the renderer
+std::array<std::pair<int, int>, 3> referenceLobes(int radius)
+{
+    const qreal gaussianScaleFactor = (3.0 * qSqrt(2.0 * M_PI) / 4.0) * 1.5;
+    const int blurRadius = qMax(2, qFloor(radius * 0.5 * gaussianScaleFactor + 0.5));
+    const int z = blurRadius / 3;
+
+    switch (blurRadius % 3) {
+    case 0:
+        return {{{z, z}, {z, z}, {z, z}}};
+    case 1:
+        return {{{z + 1, z}, {z, z + 1}, {z, z}}};
+    default:
+        return {{{z + 1, z}, {z, z + 1}, {z + 1, z + 1}}};
+    }
+}
+
+//* box filter of a line, edges clamped, rounded the way the renderer does
+std::vector<int> referenceBoxBlurLine(const std::vector<int> &line, const std::pair<int, int> &lobes)
+{
+    const int length = line.size();
+    const int boxSize = lobes.first + 1 + lobes.second;
+    const quint32 reciprocal = (1 << 24) / boxSize;
+
+    std::vector<int> blurred(length);
+    for (int i = 0; i < length; ++i) {
+        quint32 sum = (boxSize + 1) / 2;
+        for (int j = i - lobes.first; j <= i + lobes.second; ++j) {
+            sum += line[qBound(0, j, length - 1)];
+        }
+        blurred[i] = (sum * reciprocal) >> 24;
+    }
+    return blurred;
+}
+
+//* box blur of the alpha channel, one pixel at a time on a single thread
+void referenceBoxBlur(QImage &image, int radius, const QRect &rect)
+{
+    const std::array<std::pair<int, int>, 3> lobes = referenceLobes(radius);
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        std::vector<int> line;
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            line.push_back(alpha(image, x, y));
+        }
+        for (const std::pair<int, int> &lobe : lobes) {
+            line = referenceBoxBlurLine(line, lobe);
+        }
+        for (int x = rect.left(); x <= rect.right(); ++x) {
+            setAlpha(image, x, y, line[x - rect.left()]);
+        }
+    }
+
+    for (int x = rect.left(); x <= rect.right(); ++x) {
+        std::vector<int> line;
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            line.push_back(alpha(image, x, y));
+        }
+        for (const std::pair<int, int> &lobe : lobes) {
+            line = referenceBoxBlurLine(line, lobe);
+        }
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            setAlpha(image, x, y, line[y - rect.top()]);
+        }
+    }
+}
+
+} // anonymous namespace
+
+class BoxShadowRendererTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testGoldenMasks_data();
+    void testGoldenMasks();
+
+    void testMethodAccuracy_data();
+    void testMethodAccuracy();
+
+    void testSharedMasks_data();
+    void testSharedMasks();
+
+    void testPreferredMethod_data();
+    void testPreferredMethod();
+
+    void testRender_data();
+    void testRender();
+
+    void testBoxBlur_data();
+    void testBoxBlur();
+
+    void testBoxBlurLanes_data();
+    void testBoxBlurLanes();
+
+    void testExtendCorner();
+
+    void testMirrorTopLeftQuadrant_data();
+    void testMirrorTopLeftQuadrant();
+};
+
+void BoxShadowRendererTest::initTestCase()
+{
+    // keep the masks BoxShadowRenderer persists out of the user's cache
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void BoxShadowRendererTest::testGoldenMasks_data()
+{
+    QTest::addColumn<int>("preset");
+    QTest::addColumn<int>("layer");
+    QTest::addColumn<qreal>("dpr");
+    QTest::addColumn<BoxShadowRenderer::Method>("method");
+    QTest::addColumn<QString>("golden");
+
+    const BoxShadowRenderer::Method methods[] = {
+        BoxShadowRenderer::Method::BoxBlur,
+        BoxShadowRenderer::Method::Analytic,
+        BoxShadowRenderer::Method::Recursive
+    };
+
+    // The masks of the larger presets span several strips of rows and columns,
+    // so they also cover blurring in parallel.
+    for (int preset = 1; preset < s_shadowParamsCount; ++preset) {
+        for (qreal dpr : {1.0, 1.5, 2.0}) {
+            for (int layer = 0; layer < 2; ++layer) {
+                for (BoxShadowRenderer::Method method : methods) {
+                    const QString golden = QStringLiteral("mask-%1-%2-dpr%3-%4.png")
+                        .arg(QLatin1String(s_presetNames[preset])).arg(layer + 1).arg(dpr).arg(methodName(method));
+                    QTest::newRow(qPrintable(golden)) << preset << layer << dpr << method << golden;
+                }
+            }
+        }
+    }
+}
+
+void BoxShadowRendererTest::testGoldenMasks()
+{
+    QFETCH(int, preset);
+    QFETCH(int, layer);
+    QFETCH(qreal, dpr);
+    QFETCH(BoxShadowRenderer::Method, method);
+    QFETCH(QString, golden);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    const ShadowParams &shadow = layer == 0 ? params.shadow1 : params.shadow2;
+
+    const QImage mask = ShadowMask::generate(params.boxSize(borderRadius()), borderRadius(), shadow.radius, dpr, method);
+    QCOMPARE(mask.format(), QImage::Format_Alpha8);
+    QCOMPARE(mask.devicePixelRatioF(), dpr);
+
+    const QString fileName = QFINDTESTDATA(QStringLiteral("data/") + golden);
+    QVERIFY2(!fileName.isEmpty(), qPrintable(golden));
+    const QImage expected = QImage(fileName).convertToFormat(QImage::Format_Grayscale8);
+    QCOMPARE(mask.size(), expected.size());
+
+    int maxDifference = 0;
+    for (int y = 0; y < mask.height(); ++y) {
+        const uchar *actualLine = mask.constScanLine(y);
+        const uchar *expectedLine = expected.constScanLine(y);
+        for (int x = 0; x < mask.width(); ++x) {
+            maxDifference = qMax(maxDifference, qAbs(actualLine[x] - expectedLine[x]));
+        }
+    }
+
+    QVERIFY2(maxDifference <= s_goldenTolerance, qPrintable(QStringLiteral("alpha differs by up to %1").arg(maxDifference)));
+}
+
+void BoxShadowRendererTest::testMethodAccuracy_data()
+{
+    QTest::addColumn<int>("preset");
+    QTest::addColumn<int>("layer");
+    QTest::addColumn<qreal>("dpr");
+    QTest::addColumn<BoxShadowRenderer::Method>("method");
+    QTest::addColumn<int>("tolerance");
+
+    // Methods Method::Automatic picks instead of the box blur, with how far off
+    // its alpha may be. The exact gaussian doesn't round off the plateau quite
+    // like three box filters do.
+    const std::pair<BoxShadowRenderer::Method, int> methods[] = {
+        {BoxShadowRenderer::Method::Analytic, 5},
+        {BoxShadowRenderer::Method::Recursive, 10}
+    };
+
+    for (int preset = 1; preset < s_shadowParamsCount; ++preset) {
+        for (qreal dpr : {1.0, 1.5, 2.0}) {
+            for (int layer = 0; layer < 2; ++layer) {
+                for (const std::pair<BoxShadowRenderer::Method, int> &method : methods) {
+                    QTest::newRow(qPrintable(QStringLiteral("%1-%2-dpr%3-%4")
+                        .arg(QLatin1String(s_presetNames[preset])).arg(layer + 1).arg(dpr).arg(methodName(method.first))))
+                        << preset << layer << dpr << method.first << method.second;
+                }
+            }
+        }
+    }
+}
+
+void BoxShadowRendererTest::testMethodAccuracy()
+{
+    QFETCH(int, preset);
+    QFETCH(int, layer);
+    QFETCH(qreal, dpr);
+    QFETCH(BoxShadowRenderer::Method, method);
+    QFETCH(int, tolerance);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    const ShadowParams &shadow = layer == 0 ? params.shadow1 : params.shadow2;
+    const QSize boxSize = params.boxSize(borderRadius());
+
+    const QImage expected = ShadowMask::generate(boxSize, borderRadius(), shadow.radius, dpr,
+                                                 BoxShadowRenderer::Method::BoxBlur);
+    const QImage mask = ShadowMask::generate(boxSize, borderRadius(), shadow.radius, dpr, method);
+    QCOMPARE(mask.size(), expected.size());
+
+    int maxDifference = 0;
+    for (int y = 0; y < mask.height(); ++y) {
+        for (int x = 0; x < mask.width(); ++x) {
+            maxDifference = qMax(maxDifference, qAbs(alpha(mask, x, y) - alpha(expected, x, y)));
+        }
+    }
+
+    QVERIFY2(maxDifference <= tolerance, qPrintable(QStringLiteral("alpha differs by up to %1").arg(maxDifference)));
+}
+
+void BoxShadowRendererTest::testSharedMasks_data()
+{
+    QTest::addColumn<int>("preset");
+    QTest::addColumn<qreal>("dpr");
+    QTest::addColumn<BoxShadowRenderer::Method>("method");
+    QTest::addColumn<bool>("aligned");
+    QTest::addColumn<int>("tolerance");
+
+    // How far the larger mask may be off when it continues from the smaller one,
+    // three more box filters only come close to the variance that is missing.
+    const std::pair<BoxShadowRenderer::Method, int> methods[] = {
+        {BoxShadowRenderer::Method::BoxBlur, 3},
+        {BoxShadowRenderer::Method::Recursive, 10}
+    };
+
+    for (int preset = 1; preset < s_shadowParamsCount; ++preset) {
+        for (qreal dpr : {1.0, 1.5, 2.0}) {
+            // The extents of radii 64 and 32 differ by 45 pixels, that's no whole number of device pixels at 1.5.
+            const bool aligned = !(preset == s_shadowParamsCount - 1 && dpr == 1.5);
+            for (const std::pair<BoxShadowRenderer::Method, int> &method : methods) {
+                QTest::newRow(qPrintable(QStringLiteral("%1-dpr%2-%3")
+                    .arg(QLatin1String(s_presetNames[preset])).arg(dpr).arg(methodName(method.first))))
+                    << preset << dpr << method.first << aligned << method.second;
+            }
+        }
+    }
+}
+
+void BoxShadowRendererTest::testSharedMasks()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+    QFETCH(BoxShadowRenderer::Method, method);
+    QFETCH(bool, aligned);
+    QFETCH(int, tolerance);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    const QSize boxSize = params.boxSize(borderRadius());
+
+    const QImage source = ShadowMask::generate(boxSize, borderRadius(), params.shadow2.radius, dpr,
+                                               BoxShadowRenderer::Method::BoxBlur);
+    const QImage mask = ShadowMask::generateFrom(source, params.shadow2.radius, boxSize, borderRadius(),
+                                                 params.shadow1.radius, dpr, method);
+    if (!aligned) {
+        QVERIFY(mask.isNull());
+        return;
+    }
+
+    const QImage expected = ShadowMask::generate(boxSize, borderRadius(), params.shadow1.radius, dpr,
+                                                 BoxShadowRenderer::Method::BoxBlur);
+    QCOMPARE(mask.format(), QImage::Format_Alpha8);
+    QCOMPARE(mask.devicePixelRatioF(), dpr);
+    QCOMPARE(mask.size(), expected.size());
+
+    int maxDifference = 0;
+    for (int y = 0; y < mask.height(); ++y) {
+        for (int x = 0; x < mask.width(); ++x) {
+            maxDifference = qMax(maxDifference, qAbs(alpha(mask, x, y) - alpha(expected, x, y)));
+        }
+    }
+
+    QVERIFY2(maxDifference <= tolerance, qPrintable(QStringLiteral("alpha differs by up to %1").arg(maxDifference)));
+
+    // That's what the renderer hands out for the layers of the shadow.
+    if (method == BoxShadowRenderer::Method::BoxBlur) {
+        const QVector<QImage> masks = BoxShadowRenderer::renderMasks(boxSize, borderRadius(),
+                                                                     {params.shadow1.radius, params.shadow2.radius}, dpr, method);
+        QCOMPARE(masks.size(), 2);
+        QCOMPARE(masks.at(0), mask);
+        QCOMPARE(masks.at(1), source);
+    }
+}
+
+void BoxShadowRendererTest::testPreferredMethod_data()
+{
+    QTest::addColumn<int>("radius");
+    QTest::addColumn<qreal>("dpr");
+    QTest::addColumn<BoxShadowRenderer::Method>("method");
+
+    QTest::newRow("small") << 16 << 1.0 << BoxShadowRenderer::Method::BoxBlur;
+    QTest::newRow("medium") << 32 << 1.0 << BoxShadowRenderer::Method::BoxBlur;
+    QTest::newRow("large") << 48 << 1.0 << BoxShadowRenderer::Method::Recursive;
+    QTest::newRow("very large") << 64 << 1.0 << BoxShadowRenderer::Method::Analytic;
+    QTest::newRow("medium dpr 1.5") << 32 << 1.5 << BoxShadowRenderer::Method::Recursive;
+    QTest::newRow("medium dpr 2") << 32 << 2.0 << BoxShadowRenderer::Method::Analytic;
+    QTest::newRow("large dpr 1.5") << 48 << 1.5 << BoxShadowRenderer::Method::Analytic;
+}
+
+void BoxShadowRendererTest::testPreferredMethod()
+{
+    QFETCH(int, radius);
+    QFETCH(qreal, dpr);
+    QFETCH(BoxShadowRenderer::Method, method);
+
+    QCOMPARE(BoxShadowRenderer::preferredMethod(radius, dpr), method);
+
+    // Method::Automatic gives the mask of the method it picks
+    const QSize boxSize = BoxShadowRenderer::calculateNineSliceBoxSize(radius, QPoint(), borderRadius());
+    QCOMPARE(ShadowMask::generate(boxSize, borderRadius(), radius, dpr, BoxShadowRenderer::Method::Automatic),
+             ShadowMask::generate(boxSize, borderRadius(), radius, dpr, method));
+}
+
+void BoxShadowRendererTest::testRender_data()
+{
+    QTest::addColumn<int>("preset");
+    QTest::addColumn<qreal>("dpr");
+    QTest::addColumn<QColor>("color");
+
+    for (int preset = 1; preset < s_shadowParamsCount; ++preset) {
+        for (qreal dpr : {1.0, 2.0}) {
+            const QString name = QStringLiteral("%1 dpr %2").arg(QLatin1String(s_presetNames[preset])).arg(dpr);
+            QTest::newRow(qPrintable(name + QStringLiteral(" black"))) << preset << dpr << QColor(Qt::black);
+            QTest::newRow(qPrintable(name + QStringLiteral(" tinted"))) << preset << dpr << QColor(30, 60, 200, 160);
+        }
+    }
+}
+
+void BoxShadowRendererTest::testRender()
+{
+    QFETCH(int, preset);
+    QFETCH(qreal, dpr);
+    QFETCH(QColor, color);
+
+    const CompositeShadowParams &params = s_shadowParams[preset];
+    const QSize boxSize = params.boxSize(borderRadius());
+
+    BoxShadowRenderer renderer;
+    renderer.setBoxSize(boxSize);
+    renderer.setBorderRadius(borderRadius());
+    renderer.setDevicePixelRatio(dpr);
+
+    QColor color1(color);
+    color1.setAlphaF(color.alphaF() * params.shadow1.opacity);
+    renderer.addShadow(params.shadow1.offset, params.shadow1.radius, color1);
+
+    QColor color2(color);
+    color2.setAlphaF(color.alphaF() * params.shadow2.opacity);
+    renderer.addShadow(params.shadow2.offset, params.shadow2.radius, color2);
+
+    const QImage texture = renderer.render();
+    QCOMPARE(texture.format(), QImage::Format_ARGB32_Premultiplied);
+    QCOMPARE(texture.devicePixelRatioF(), dpr);
+
+    // The same masks, tinted in SourceIn mode and drawn with QPainter.
+    QImage expected(texture.size(), QImage::Format_ARGB32_Premultiplied);
+    expected.setDevicePixelRatio(dpr);
+    expected.fill(Qt::transparent);
+
+    QRect boxRect(QPoint(0, 0), boxSize);
+    boxRect.moveCenter(QRect(QPoint(0, 0), texture.size() / dpr).center());
+
+    const QVector<QImage> masks = BoxShadowRenderer::renderMasks(boxSize, borderRadius(),
+                                                                 {params.shadow1.radius, params.shadow2.radius}, dpr);
+
+    QPainter painter(&expected);
+    const std::pair<ShadowParams, QColor> shadows[] = {{params.shadow1, color1}, {params.shadow2, color2}};
+    for (int i = 0; i < 2; ++i) {
+        const std::pair<ShadowParams, QColor> &shadow = shadows[i];
+        const QImage &mask = masks.at(i);
+
+        QImage tinted = mask.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QPainter tintPainter(&tinted);
+        tintPainter.setCompositionMode(QPainter::CompositionMode_SourceIn);
+        tintPainter.fillRect(tinted.rect(), shadow.second);
+        tintPainter.end();
+
+        QRect shadowRect(QPoint(0, 0), mask.size() / dpr);
+        shadowRect.moveCenter(boxRect.center() + shadow.first.offset);
+        painter.drawImage(shadowRect, tinted);
+    }
+    painter.end();
+
+    QCOMPARE(texture, expected);
+}
+
+void BoxShadowRendererTest::testBoxBlur_data()
+{
+    QTest::addColumn<QImage>("image");
+    QTest::addColumn<int>("radius");
+    QTest::addColumn<QRect>("rect");
+    QTest::addColumn<ShadowMask::VerticalPass>("verticalPass");
+
+    const std::pair<const char *, ShadowMask::VerticalPass> verticalPasses[] = {
+        {"", ShadowMask::VerticalPass::Direct},
+        {" tiled", ShadowMask::VerticalPass::Tiled}
+    };
+
+    // Sizes that are no multiple of the lanes of the vector kernels nor of the
+    // strips of rows and columns that are blurred in parallel, nor of the tiles.
+    for (const auto &verticalPass : verticalPasses) {
+        const auto row = [&verticalPass](const char *name) -> QTestData & {
+            return QTest::newRow(qPrintable(QLatin1String(name) + QLatin1String(verticalPass.first)));
+        };
+        row("alpha8") << randomImage(QSize(45, 31), QImage::Format_Alpha8, 1) << 8 << QRect() << verticalPass.second;
+        row("alpha8 minimum radius") << randomImage(QSize(45, 31), QImage::Format_Alpha8, 2) << 2 << QRect() << verticalPass.second;
+        row("alpha8 parallel") << randomImage(QSize(517, 389), QImage::Format_Alpha8, 3) << 64 << QRect() << verticalPass.second;
+        row("alpha8 rect") << randomImage(QSize(300, 200), QImage::Format_Alpha8, 4) << 33 << QRect(13, 7, 251, 149) << verticalPass.second;
+        row("argb32") << randomImage(QSize(45, 31), QImage::Format_ARGB32_Premultiplied, 5) << 8 << QRect() << verticalPass.second;
+        row("argb32 parallel") << randomImage(QSize(333, 271), QImage::Format_ARGB32_Premultiplied, 6) << 24 << QRect() << verticalPass.second;
+    }
+}
+
+void BoxShadowRendererTest::testBoxBlur()
+{
+    QFETCH(QImage, image);
+    QFETCH(int, radius);
+    QFETCH(QRect, rect);
+    QFETCH(ShadowMask::VerticalPass, verticalPass);
+
+    QImage expected = image.copy();
+    referenceBoxBlur(expected, radius, rect.isNull() ? image.rect() : rect);
+
+    ShadowMask::boxBlur(image, radius, rect, verticalPass);
+
+    // everything but the alpha values within the rect must stay as is
+    QCOMPARE(image, expected);
+}
+
+void BoxShadowRendererTest::testBoxBlurLanes_data()
+{
+    QTest::addColumn<QByteArray>("kernel");
+    QTest::addColumn<int>("step");
+    QTest::addColumn<int>("laneStep");
+    QTest::addColumn<int>("length");
+    QTest::addColumn<int>("left");
+    QTest::addColumn<int>("right");
+
+    // The layouts boxBlur hands to the kernels: packed scratch buffers, rows of
+    // masks and of ARGB images, and columns of both. Lengths are no multiple of
+    // anything, lobes are uneven and range from a single pixel to a wide box.
+    const std::pair<const char *, std::pair<int, int>> layouts[] = {
+        {"packed", {8, 1}},
+        {"alpha8 rows", {1, 61}},
+        {"argb32 rows", {4, 244}},
+        {"alpha8 columns", {61, 1}},
+        {"argb32 columns", {244, 4}}
+    };
+    const std::pair<int, int> lobes[] = {{0, 0}, {1, 0}, {3, 2}, {14, 15}};
+
+    for (const char *kernel : {"sse2", "avx2"}) {
+        for (const auto &layout : layouts) {
+            for (const std::pair<int, int> &lobe : lobes) {
+                QTest::newRow(qPrintable(QStringLiteral("%1 %2 %3-%4")
+                    .arg(QLatin1String(kernel)).arg(QLatin1String(layout.first)).arg(lobe.first).arg(lobe.second)))
+                    << QByteArray(kernel) << layout.second.first << layout.second.second << 53 << lobe.first << lobe.second;
+            }
+        }
+    }
+}
+
+void BoxShadowRendererTest::testBoxBlurLanes()
+{
+    QFETCH(QByteArray, kernel);
+    QFETCH(int, step);
+    QFETCH(int, laneStep);
+    QFETCH(int, length);
+    QFETCH(int, left);
+    QFETCH(int, right);
+
+    // call the kernels directly, boxBlur only runs the one picked for this CPU
+    BoxBlurLanesFunction blurLanes = nullptr;
+    int lanes = 0;
+    if (kernel == "sse2") {
+#if defined(__SSE2__)
+        blurLanes = boxBlurLanesSse2;
+        lanes = 4;
+#endif
+    } else {
+#if BREEZE_COMMON_HAVE_AVX2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            blurLanes = boxBlurLanesAvx2;
+            lanes = 8;
+        }
+#endif
+    }
+    if (!blurLanes) {
+        QSKIP("kernel not supported by the compiler or the CPU");
+    }
+
+    const int size = (length - 1) * step + (lanes - 1) * laneStep + 1;
+    QRandomGenerator random(quint32(step * 1000 + laneStep + left * 10 + right));
+    std::vector<uint8_t> src(size);
+    for (uint8_t &value : src) {
+        value = static_cast<uint8_t>(random.bounded(256));
+    }
+
+    // bytes that are no alpha values of a lane must stay as they are
+    std::vector<uint8_t> dst(size, 0xa5);
+    const BoxLobes lobe = {left, right};
+    blurLanes(src.data(), step, laneStep, dst.data(), step, laneStep, length, lobe);
+
+    std::vector<uint8_t> expected(size, 0xa5);
+    for (int lane = 0; lane < lanes; ++lane) {
+        ShadowMask::boxBlurRow(src.data() + lane * laneStep, step, expected.data() + lane * laneStep, step, length, lobe);
+    }
+
+    QVERIFY(dst == expected);
+}
+
+void BoxShadowRendererTest::testExtendCorner()
+{
+    const QSize corner(4, 3);
+    const QSize quadrant(6, 5);
+
+    const QImage original = randomImage(QSize(10, 8), QImage::Format_Alpha8, 7);
+    QImage image = original.copy();
+    ShadowMask::extendCorner(image, corner, quadrant);
+
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            int expected = alpha(original, x, y);
+            if (x < quadrant.width() && y < quadrant.height()) {
+                expected = alpha(original, qMin(x, corner.width() - 1), qMin(y, corner.height() - 1));
+            }
+            QCOMPARE(alpha(image, x, y), expected);
+        }
+    }
+}
+
+void BoxShadowRendererTest::testMirrorTopLeftQuadrant_data()
+{
+    QTest::addColumn<QImage>("image");
+
+    QTest::newRow("alpha8 even") << randomImage(QSize(8, 6), QImage::Format_Alpha8, 8);
+    QTest::newRow("alpha8 odd") << randomImage(QSize(7, 5), QImage::Format_Alpha8, 9);
+    QTest::newRow("argb32 odd") << randomImage(QSize(9, 7), QImage::Format_ARGB32_Premultiplied, 10);
+}
+
+void BoxShadowRendererTest::testMirrorTopLeftQuadrant()
+{
+    QFETCH(QImage, image);
+
+    const QImage original = image.copy();
+    ShadowMask::mirrorTopLeftQuadrant(image);
+
+    const int centerX = qCeil(image.width() * 0.5);
+    const int centerY = qCeil(image.height() * 0.5);
+
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            const int quadrantX = x < centerX ? x : image.width() - 1 - x;
+            const int quadrantY = y < centerY ? y : image.height() - 1 - y;
+            QCOMPARE(alpha(image, x, y), alpha(original, quadrantX, quadrantY));
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(BoxShadowRendererTest)
+
+#include "boxshadowrenderertest.moc"
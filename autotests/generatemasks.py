@@ -0,0 +1,328 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+"""
+Generate the golden shadow masks of boxshadowrenderertest.
+
+This is an independent, straightforward port of the mask pipeline of
+BoxShadowRenderer: the box is rasterized with the same QPainter calls, all
+other stages are plain numpy without any of the strips, lanes, threads or
+shortcuts of the C++ code. Run it after intentional changes to how masks look:
+
+    QT_QPA_PLATFORM=offscreen python3 generatemasks.py
+
+Needs PyQt5 and numpy.
+"""
+
+import math
+import os
+import sys
+
+import numpy as np
+from PyQt5.QtCore import QPoint, QRect, QSize, Qt
+from PyQt5.QtGui import QImage, QPainter
+
+# Keep in sync with s_shadowParams in breezeshadowparams.h, as
+# (name, [(offset, radius), (offset, radius)]).
+PRESETS = [
+    ("small", [((0, 0), 16), ((0, -2), 8)]),
+    ("medium", [((0, 0), 32), ((0, -4), 16)]),
+    ("large", [((0, 0), 48), ((0, -6), 24)]),
+    ("verylarge", [((0, 0), 64), ((0, -8), 32)]),
+]
+
+DEVICE_PIXEL_RATIOS = [1.0, 1.5, 2.0]
+
+# Keep in sync with boxshadowrenderertest.cpp.
+SMALL_SPACING = 2
+CORNER_RADIUS = 0
+
+BOX_BLUR, ANALYTIC, RECURSIVE = range(3)
+METHOD_NAMES = {BOX_BLUR: "boxblur", ANALYTIC: "analytic", RECURSIVE: "recursive"}
+
+
+def q_round(value):
+    # qRound of a non-negative number
+    return int(math.floor(value + 0.5))
+
+
+def calculate_blur_radius(std_dev):
+    gaussian_scale_factor = (3.0 * math.sqrt(2.0 * math.pi) / 4.0) * 1.5
+    return max(2, int(math.floor(std_dev * gaussian_scale_factor + 0.5)))
+
+
+def calculate_blur_extent(radius):
+    return calculate_blur_radius(radius * 0.5)
+
+
+def compute_lobes(radius):
+    blur_radius = calculate_blur_extent(radius)
+    z = blur_radius // 3
+    if blur_radius % 3 == 0:
+        major, minor, final = z, z, z
+    elif blur_radius % 3 == 1:
+        major, minor, final = z + 1, z, z
+    else:
+        major, minor, final = z + 1, z, z + 1
+    return [(major, minor), (minor, major), (final, final)]
+
+
+def calculate_lobes_std_dev(radius):
+    variance = 0.0
+    for left, right in compute_lobes(radius):
+        box_size = left + 1 + right
+        variance += (box_size * box_size - 1) / 12.0
+    return math.sqrt(variance)
+
+
+def nine_slice_box_size(radius, offset, border_radius):
+    corner_size = math.ceil(border_radius)
+    extent = calculate_blur_extent(radius)
+    return (2 * (extent + corner_size + abs(offset[0])) + 1,
+            2 * (extent + corner_size + abs(offset[1])) + 1)
+
+
+def box_blur_lines(lines, lobes):
+    """Box blur along the last axis, edges clamped, rounded like the C++ code."""
+    left, right = lobes
+    box_size = left + 1 + right
+    reciprocal = (1 << 24) // box_size
+    padded = np.pad(lines.astype(np.uint64), [(0, 0), (left, right)], mode="edge")
+    sums = np.cumsum(padded, axis=1)
+    sums = np.concatenate([np.zeros((sums.shape[0], 1), np.uint64), sums], axis=1)
+    window = sums[:, box_size:] - sums[:, :-box_size]
+    return (((window + (box_size + 1) // 2) * reciprocal) >> 24).astype(np.uint8)
+
+
+def box_blur(block, radius):
+    if radius < 2:
+        return block
+    lobes = compute_lobes(radius)
+    for lobe in lobes:
+        block = box_blur_lines(block, lobe)
+    block = block.T
+    for lobe in lobes:
+        block = box_blur_lines(block, lobe)
+    return block.T.copy()
+
+
+def recursive_gaussian_coefficients(std_dev):
+    if std_dev >= 2.5:
+        q = 0.98711 * std_dev - 0.96330
+    else:
+        q = 3.97156 - 4.14554 * math.sqrt(1.0 - 0.26891 * std_dev)
+    q2 = q * q
+    q3 = q2 * q
+    b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3
+    b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3
+    b2 = -(1.4281 * q2 + 1.26661 * q3)
+    b3 = 0.422205 * q3
+    return [np.float32(v) for v in (1.0 - (b1 + b2 + b3) / b0, b1 / b0, b2 / b0, b3 / b0)]
+
+
+def recursive_gaussian_lines(lines, coefficients):
+    """Forward and backward recursive gaussian along the first axis, in float."""
+    gain, f1, f2, f3 = coefficients
+    data = lines.astype(np.float32).copy()
+    count = data.shape[0]
+
+    edge = data[0].copy()
+    for i in range(count):
+        p1 = data[i - 1] if i >= 1 else edge
+        p2 = data[i - 2] if i >= 2 else edge
+        p3 = data[i - 3] if i >= 3 else edge
+        data[i] = gain * data[i] + f1 * p1 + f2 * p2 + f3 * p3
+
+    edge = data[count - 1].copy()
+    for i in range(count - 1, -1, -1):
+        n1 = data[i + 1] if i + 1 < count else edge
+        n2 = data[i + 2] if i + 2 < count else edge
+        n3 = data[i + 3] if i + 3 < count else edge
+        data[i] = gain * data[i] + f1 * n1 + f2 * n2 + f3 * n3
+
+    return data
+
+
+def recursive_blur(block, std_dev):
+    coefficients = recursive_gaussian_coefficients(std_dev)
+    rows = recursive_gaussian_lines(block.T, coefficients).T
+    columns = recursive_gaussian_lines(rows, coefficients)
+    return np.clip(np.floor(columns + np.float32(0.5)), 0, 255).astype(np.uint8)
+
+
+def fast_erf(x):
+    a = np.abs(x)
+    t = 1.0 + (0.278393 + (0.230389 + 0.078108 * (a * a)) * a) * a
+    t = t * t
+    value = 1.0 - 1.0 / (t * t)
+    return np.where(x < 0, -value, value)
+
+
+def render_analytic(width, height, box, corner_radius, std_dev):
+    """Closed form of a gaussian blurred rounded box, see renderAnalyticAlpha."""
+    segment_count = 8
+    bx, by, bw, bh = box
+    center_x = bx + bw * 0.5
+    center_y = by + bh * 0.5
+    half_width = bw * 0.5
+    half_height = bh * 0.5
+    radius = min(corner_radius, half_width, half_height)
+    scale = 1.0 / (std_dev * math.sqrt(2.0))
+
+    xs = np.arange(width) + 0.5 - center_x
+
+    def integrate_span(x, half_span):
+        return 0.5 * (fast_erf((x + half_span) * scale) - fast_erf((x - half_span) * scale))
+
+    straight_profile = integrate_span(xs, half_width)
+
+    out = np.zeros((height, width), np.uint8)
+    for j in range(height):
+        y = j + 0.5 - center_y
+        start = min(max(-4.0 * std_dev, y - half_height), y + half_height)
+        end = min(max(4.0 * std_dev, y - half_height), y + half_height)
+        step = (end - start) / segment_count
+
+        straight_weight = 0.0
+        curved_segments = []
+        lower_mass = 0.5 * float(fast_erf(np.float64(start * scale)))
+        for k in range(segment_count if step > 0 else 0):
+            upper_mass = 0.5 * float(fast_erf(np.float64((start + (k + 1) * step) * scale)))
+            weight = upper_mass - lower_mass
+            lower_mass = upper_mass
+
+            box_y = y - (start + (k + 0.5) * step)
+            delta = half_height - radius - abs(box_y)
+            if delta >= 0:
+                straight_weight += weight
+            else:
+                half_span = half_width - radius + math.sqrt(max(0.0, radius * radius - delta * delta))
+                curved_segments.append((weight, half_span))
+
+        # summed in the same order as in C++
+        value = straight_weight * straight_profile
+        for weight, half_span in curved_segments:
+            value = value + weight * integrate_span(xs, half_span)
+        out[j] = np.clip(np.floor(value * 255 + 0.5), 0, 255).astype(np.uint8)
+    return out
+
+
+def rasterize(size, box_rect, x_radius, y_radius, dpr):
+    image = QImage(QSize(q_round(size[0] * dpr), q_round(size[1] * dpr)), QImage.Format_Alpha8)
+    image.setDevicePixelRatio(dpr)
+    image.fill(0)
+
+    painter = QPainter()
+    painter.begin(image)
+    painter.setRenderHint(QPainter.Antialiasing)
+    painter.setPen(Qt.NoPen)
+    painter.setBrush(Qt.black)
+    painter.drawRoundedRect(box_rect, x_radius, y_radius)
+    painter.end()
+
+    data = image.constBits().asstring(image.bytesPerLine() * image.height())
+    return np.frombuffer(data, np.uint8).reshape(image.height(), image.bytesPerLine())[:, :image.width()].copy()
+
+
+def generate_mask(box_size, border_radius, radius, dpr, method):
+    inflation = calculate_blur_extent(radius)
+    size = (box_size[0] + 2 * inflation, box_size[1] + 2 * inflation)
+    mask_width = q_round(size[0] * dpr)
+    mask_height = q_round(size[1] * dpr)
+
+    box_rect = QRect(QPoint(0, 0), QSize(*box_size))
+    box_rect.moveCenter(QRect(QPoint(0, 0), QSize(*size)).center())
+
+    x_radius = 2.0 * border_radius / box_rect.width()
+    y_radius = 2.0 * border_radius / box_rect.height()
+
+    quadrant = (math.ceil(mask_width * 0.5), math.ceil(mask_height * 0.5))
+    scaled_radius = q_round(radius * dpr)
+
+    recursive = method == RECURSIVE and scaled_radius >= 2
+    std_dev = calculate_lobes_std_dev(scaled_radius)
+    blur_extent = calculate_blur_extent(scaled_radius)
+    corner = (math.ceil((box_rect.x() + x_radius) * dpr) + blur_extent + 2,
+              math.ceil((box_rect.y() + y_radius) * dpr) + blur_extent + 2)
+    blur = (min(corner[0], quadrant[0]), min(corner[1], quadrant[1]))
+
+    # the recursive gaussian filters the box for another 4 sigmas past the corner
+    margin = math.ceil(4.0 * std_dev)
+    block = blur
+    if recursive:
+        block = (min(blur[0] + margin, mask_width), min(blur[1] + margin, mask_height))
+
+    if method == ANALYTIC and scaled_radius >= 2:
+        mask = np.zeros((mask_height, mask_width), np.uint8)
+        box = (box_rect.x() * dpr, box_rect.y() * dpr, box_rect.width() * dpr, box_rect.height() * dpr)
+        mask[:blur[1], :blur[0]] = render_analytic(blur[0], blur[1], box, min(x_radius, y_radius) * dpr, std_dev)
+    else:
+        mask = rasterize(size, box_rect, x_radius, y_radius, dpr)
+        if recursive:
+            mask[:block[1], :block[0]] = recursive_blur(mask[:block[1], :block[0]], std_dev)
+        else:
+            mask[:blur[1], :blur[0]] = box_blur(mask[:blur[1], :blur[0]], scaled_radius)
+
+    # extend the corner
+    mask[:blur[1], blur[0]:quadrant[0]] = mask[:blur[1], blur[0] - 1:blur[0]]
+    mask[blur[1]:quadrant[1], :quadrant[0]] = mask[blur[1] - 1, :quadrant[0]]
+
+    # mirror the top-left quadrant
+    mask[:quadrant[1], mask_width - quadrant[0]:] = mask[:quadrant[1], :quadrant[0]][:, ::-1]
+    mask[mask_height - quadrant[1]:, :] = mask[:quadrant[1], :][::-1, :]
+
+    return mask
+
+
+def golden_name(preset, layer, dpr, method):
+    return "mask-%s-%d-dpr%s-%s.png" % (preset, layer + 1, ("%g" % dpr), METHOD_NAMES[method])
+
+
+def save(mask, path):
+    height, width = mask.shape
+    image = QImage(width, height, QImage.Format_Grayscale8)
+    for y in range(height):
+        line = image.scanLine(y)
+        line.setsize(width)
+        line[:] = mask[y].tobytes()
+    if not image.save(path):
+        sys.exit("cannot write " + path)
+
+
+def main():
+    data_directory = os.path.join(os.path.dirname(os.path.abspath(__file__)), "data")
+    os.makedirs(data_directory, exist_ok=True)
+
+    border_radius = 0.5 * SMALL_SPACING * (CORNER_RADIUS + 0.5)
+
+    for preset, layers in PRESETS:
+        width = height = 0
+        for offset, radius in layers:
+            size = nine_slice_box_size(radius, offset, border_radius)
+            width = max(width, size[0])
+            height = max(height, size[1])
+
+        for dpr in DEVICE_PIXEL_RATIOS:
+            for layer, (offset, radius) in enumerate(layers):
+                for method in (BOX_BLUR, ANALYTIC, RECURSIVE):
+                    mask = generate_mask((width, height), border_radius, radius, dpr, method)
+                    save(mask, os.path.join(data_directory, golden_name(preset, layer, dpr, method)))
+
+
+if __name__ == "__main__":
+    main()
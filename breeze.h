@@ -50,6 +50,14 @@ namespace Breeze
         // shadow dimensions (pixels)
         Shadow_Overlap = 3,
 
+        // the placeholder shown until the first shadow of a window is rendered
+        // is blurred at this fraction of the scale, and upscaled
+        Shadow_PlaceholderDownscale = 4,
+
+        // shadow cross-fade on focus change, in blended frames
+        // every frame is a new texture for the compositor, so they are kept few
+        Shadow_TransitionSteps = 4,
+
     };
 
     //* standard pen widths
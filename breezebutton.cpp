@@ -116,10 +116,12 @@ namespace Breeze
 
     void Button::paint(QPainter *painter, const QRect &repaintRegion)
     {
-        Q_UNUSED(repaintRegion)
-
         if (!decoration()) return;
 
+        // the button group paints all buttons, whatever was damaged.
+        // Standalone buttons, as in the configuration preview, and invalid regions always paint
+        if (!isStandAlone() && repaintRegion.isValid() && !geometry().toAlignedRect().intersects(repaintRegion)) return;
+
         painter->save();
 
         if (!m_iconSize.isValid() || isStandAlone()) m_iconSize = geometry().size().toSize();
@@ -154,11 +156,10 @@ namespace Breeze
 
     }
 
-    void Button::drawButtonbackground(QPainter* painter, QColor button_color, QColor titleBarColor) const {
+    void Button::drawButtonbackground(QPainter* painter, const QColor &button_color, const QColor &border_color) const {
       qreal const width(m_iconSize.width());
-      int const titlebarColorGrayness = qGray(titleBarColor.rgb());
 
-      QPen button_pen( titlebarColorGrayness < 69 ? button_color.lighter(115) : button_color.darker(115) );
+      QPen button_pen( border_color );
       button_pen.setJoinStyle( Qt::MiterJoin );
       button_pen.setWidthF( 9./7.*PenWidth::Symbol*qMax((qreal)1.0, 20/width ) );
       painter->setPen( button_pen );
@@ -198,38 +199,22 @@ namespace Breeze
         // painter->scale(0.8, 0.8);
         // painter->translate(4, 4); // TODO: Calculate scaling offset
 
-        bool const inactiveWindow (d && !d->client().toStrongRef().data()->isActive());
-        bool const isMatchTitleBarColor (d && d->internalSettings()->matchColorForTitleBar());
-
-        QColor const darkSymbolColor( ( inactiveWindow && isMatchTitleBarColor ) ? QColor(250, 251, 252) : QColor(34, 45, 50) );
-        QColor const lightSymbolColor( ( inactiveWindow && isMatchTitleBarColor ) ? QColor(192, 193, 194) : QColor(250, 251, 252) );
-
-        QColor const titleBarColor (d->titleBarColor());
+        // colors are resolved by the decoration, once for all its buttons
+        ColorPalette const &colors( d->colorPalette() );
+        bool const inactiveWindow( !colors.active );
 
         // symbols pen
-        QColor const symbolColor = darkSymbolColor;
+        QColor const symbolColor = colors.symbol;
         QPen symbol_pen( symbolColor );
         symbol_pen.setJoinStyle( Qt::MiterJoin );
         symbol_pen.setWidthF( 9./7.*1.7*qMax((qreal)1.0, 20/width ) );
 
-        int const titlebarColorGrayness = qGray(titleBarColor.rgb());
         int const margin = (m_iconSize.width() / 2) / 1.35; // 2 = Touches orb border, 0 = Very Smol
 
         switch(type()) {
 
             case DecorationButtonType::Close: {
-                QColor button_color;
-                if (!inactiveWindow && titlebarColorGrayness < 128) {
-                  button_color = QColor(238, 102, 90);
-                } else if (!inactiveWindow) {
-                  button_color = QColor(255, 97, 89);
-                } else if (titlebarColorGrayness < 128) {
-                  button_color = QColor(100, 100, 100);
-                } else {
-                  button_color = QColor(200, 200, 200);
-                }
-
-                drawButtonbackground(painter, button_color, titleBarColor);
+                drawButtonbackground(painter, colors.buttonBackground(type()), colors.buttonBorder(type()));
 
                 if (this->hovered()) {
                   // Hardcoded color since I don't know the original color
@@ -252,18 +237,7 @@ namespace Breeze
             }
 
             case DecorationButtonType::Maximize: {
-                QColor button_color;
-                if (!inactiveWindow && titlebarColorGrayness < 128) {
-                  button_color = QColor(100, 196, 86);
-                } else if (!inactiveWindow) {
-                  button_color = QColor(41, 204, 65);
-                } else if (titlebarColorGrayness < 128) {
-                  button_color = QColor(100, 100, 100);
-                } else {
-                  button_color = QColor(200, 200, 200);
-                }
-
-                drawButtonbackground(painter, button_color, titleBarColor);
+                drawButtonbackground(painter, colors.buttonBackground(type()), colors.buttonBorder(type()));
 
                 if (this->hovered()) {
                   painter->setPen(Qt::NoPen);
@@ -314,18 +288,7 @@ namespace Breeze
 
             case DecorationButtonType::Minimize:
             {
-                QColor button_color;
-                if (!inactiveWindow && titlebarColorGrayness < 128) {
-                  button_color = QColor(223, 192, 76);
-                }else if (!inactiveWindow){
-                  button_color = QColor(255, 193, 46);
-                } else if (titlebarColorGrayness < 128) {
-                  button_color = QColor(100, 100, 100);
-                } else {
-                  button_color = QColor(200, 200, 200);
-                }
-
-                drawButtonbackground(painter, button_color, titleBarColor);
+                drawButtonbackground(painter, colors.buttonBackground(type()), colors.buttonBorder(type()));
 
                 if (this->hovered()) {
                   if (!inactiveWindow) {
@@ -343,16 +306,7 @@ namespace Breeze
             }
 
             case DecorationButtonType::OnAllDesktops: {
-                QColor button_color;
-                if (!inactiveWindow)
-                  button_color = QColor(125, 209, 200);
-                else if (titlebarColorGrayness < 128)
-                  button_color = QColor(100, 100, 100);
-                else
-                  button_color = QColor(200, 200, 200);
-                QPen button_pen( titlebarColorGrayness < 69 ? button_color.lighter(115) : button_color.darker(115) );
-
-                drawButtonbackground(painter, button_color, titleBarColor);
+                drawButtonbackground(painter, colors.buttonBackground(type()), colors.buttonBorder(type()));
 
                 if (this->hovered() || isChecked()) {
                   painter->setPen(Qt::NoPen);
@@ -366,15 +320,7 @@ namespace Breeze
             }
 
             case DecorationButtonType::Shade: {
-                QColor button_color;
-                if (!inactiveWindow)
-                  button_color = QColor(204, 176, 213);
-                else if (titlebarColorGrayness < 128)
-                  button_color = QColor(100, 100, 100);
-                else
-                  button_color = QColor(200, 200, 200);
-
-                drawButtonbackground(painter, button_color, titleBarColor);
+                drawButtonbackground(painter, colors.buttonBackground(type()), colors.buttonBorder(type()));
 
                 if (isChecked()) {
                     painter->setPen(symbol_pen);
@@ -403,15 +349,7 @@ namespace Breeze
 
             case DecorationButtonType::KeepBelow:
             {
-                QColor button_color;
-                if ( !inactiveWindow )
-                  button_color = QColor(255, 137, 241);
-                else if ( titlebarColorGrayness < 128 )
-                  button_color = QColor(100, 100, 100);
-                else
-                  button_color = QColor(200, 200, 200);
-
-                drawButtonbackground(painter, button_color, titleBarColor);
+                drawButtonbackground(painter, colors.buttonBackground(type()), colors.buttonBorder(type()));
 
                 if ( this->hovered() || isChecked() )
                 {
@@ -432,15 +370,7 @@ namespace Breeze
 
             case DecorationButtonType::KeepAbove:
             {
-                QColor button_color;
-                if ( !inactiveWindow )
-                  button_color = QColor(135, 206, 249);
-                else if ( titlebarColorGrayness < 128 )
-                  button_color = QColor(100, 100, 100);
-                else
-                  button_color = QColor(200, 200, 200);
-
-                drawButtonbackground(painter, button_color, titleBarColor);
+                drawButtonbackground(painter, colors.buttonBackground(type()), colors.buttonBorder(type()));
 
                 if ( this->hovered() || isChecked() )
                 {
@@ -457,22 +387,7 @@ namespace Breeze
 
             case DecorationButtonType::ApplicationMenu:
             {
-                QColor menuSymbolColor;
-                bool isSystemForegroundColor( d && d->internalSettings()->systemForegroundColor() );
-                if (isSystemForegroundColor)
-                  menuSymbolColor = this->fontColor();
-                else {
-                  uint r = qRed(titleBarColor.rgb());
-                  uint g = qGreen(titleBarColor.rgb());
-                  uint b = qBlue(titleBarColor.rgb());
-                  qreal colorConditional = 0.299 * static_cast<qreal>(r) + 0.587 * static_cast<qreal>(g) + 0.114 * static_cast<qreal>(b);
-                  if ( colorConditional > 186 || g > 186 )
-                    menuSymbolColor = darkSymbolColor;
-                  else
-                    menuSymbolColor = lightSymbolColor;
-                }
-
-                QPen menuSymbol_pen( menuSymbolColor );
+                QPen menuSymbol_pen( colors.menuSymbol );
                 menuSymbol_pen.setJoinStyle( Qt::MiterJoin );
                 menuSymbol_pen.setWidthF( 1.7*qMax((qreal)1.0, 20/width ) );
 
@@ -487,15 +402,7 @@ namespace Breeze
 
             case DecorationButtonType::ContextHelp:
             {
-                QColor button_color;
-                if ( !inactiveWindow )
-                  button_color = QColor(102, 156, 246);
-                else if ( titlebarColorGrayness < 128 )
-                  button_color = QColor(100, 100, 100);
-                else
-                  button_color = QColor(200, 200, 200);
-
-                drawButtonbackground(painter, button_color, titleBarColor);
+                drawButtonbackground(painter, colors.buttonBackground(type()), colors.buttonBorder(type()));
 
                 if ( this->hovered() || isChecked() )
                 {
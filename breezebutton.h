@@ -87,7 +87,7 @@ namespace Breeze
         explicit Button(KDecoration2::DecorationButtonType type, Decoration *decoration, QObject *parent = nullptr);
 
         /// Draw window buttons
-        void drawButtonbackground(QPainter*, QColor button_color, QColor titleBarColor) const;
+        void drawButtonbackground(QPainter*, const QColor &button_color, const QColor &border_color) const;
         void drawWindowButtons(QPainter*) const;
 
         //*@name colors
@@ -32,6 +32,9 @@
 #include "breezesizegrip.h"
 
 #include "breezeboxshadowrenderer.h"
+#include "breezeshadowcache.h"
+#include "breezeshadowcrossfade.h"
+#include "breezeshadowparams.h"
 
 #include <KDecoration2/DecoratedClient>
 #include <KDecoration2/DecorationButtonGroup>
@@ -63,102 +66,41 @@ K_PLUGIN_FACTORY_WITH_JSON(
 
 namespace
 {
-    struct ShadowParams {
-        ShadowParams()
-            : offset(QPoint(0, 0))
-            , radius(0)
-            , opacity(0) {}
-
-        ShadowParams(const QPoint &offset, int radius, qreal opacity)
-            : offset(offset)
-            , radius(radius)
-            , opacity(opacity) {}
-
-        QPoint offset;
-        int radius;
-        qreal opacity;
-    };
-
-    struct CompositeShadowParams {
-        CompositeShadowParams() = default;
-
-        CompositeShadowParams(
-                const QPoint &offset,
-                const ShadowParams &shadow1,
-                const ShadowParams &shadow2)
-            : offset(offset)
-            , shadow1(shadow1)
-            , shadow2(shadow2) {}
-
-        bool isNone() const {
-            return qMax(shadow1.radius, shadow2.radius) == 0;
-        }
-
-        QPoint offset;
-        ShadowParams shadow1;
-        ShadowParams shadow2;
-    };
-
-    const CompositeShadowParams s_shadowParams[] = {
-        // None
-        CompositeShadowParams(),
-        // Small
-        CompositeShadowParams(
-            QPoint(0, 4),
-            ShadowParams(QPoint(0, 0), 16, 1),
-            ShadowParams(QPoint(0, -2), 8, 0.4)),
-        // Medium
-        CompositeShadowParams(
-            QPoint(0, 8),
-            ShadowParams(QPoint(0, 0), 32, 0.9),
-            ShadowParams(QPoint(0, -4), 16, 0.3)),
-        // Large
-        CompositeShadowParams(
-            QPoint(0, 12),
-            ShadowParams(QPoint(0, 0), 48, 0.8),
-            ShadowParams(QPoint(0, -6), 24, 0.2)),
-        // Very large
-        CompositeShadowParams(
-            QPoint(0, 16),
-            ShadowParams(QPoint(0, 0), 64, 0.7),
-            ShadowParams(QPoint(0, -8), 32, 0.1))
-    };
-
-    inline CompositeShadowParams lookupShadowParams(int size)
+    inline int lookupShadowParamsIndex(int size)
     {
         switch (size) {
         case Breeze::InternalSettings::ShadowNone:
-            return s_shadowParams[0];
+            return 0;
         case Breeze::InternalSettings::ShadowSmall:
-            return s_shadowParams[1];
+            return 1;
         case Breeze::InternalSettings::ShadowMedium:
-            return s_shadowParams[2];
+            return 2;
         case Breeze::InternalSettings::ShadowLarge:
-            return s_shadowParams[3];
+            return 3;
         case Breeze::InternalSettings::ShadowVeryLarge:
-            return s_shadowParams[4];
+            return 4;
         default:
             // Fallback to the Large size.
-            return s_shadowParams[3];
+            return 3;
         }
     }
 
-    inline CompositeShadowParams lookupShadowParamsInactiveWindows(int size)
+    inline int lookupShadowParamsIndexInactiveWindows(int size)
     {
         switch (size) {
         case Breeze::InternalSettings::ShadowNoneInactiveWindows:
-            return s_shadowParams[0];
+            return 0;
         case Breeze::InternalSettings::ShadowSmallInactiveWindows:
-            return s_shadowParams[1];
+            return 1;
         case Breeze::InternalSettings::ShadowMediumInactiveWindows:
-            return s_shadowParams[2];
+            return 2;
         case Breeze::InternalSettings::ShadowLargeInactiveWindows:
-            return s_shadowParams[3];
+            return 3;
         case Breeze::InternalSettings::ShadowVeryLargeInactiveWindows:
-            return s_shadowParams[4];
+            return 4;
         default:
             // Fallback to the Large size.
-            return s_shadowParams[3];
+            return 3;
         }
     }
 }
@@ -170,18 +112,11 @@ namespace Breeze
     using KDecoration2::ColorGroup;
 
     static int g_sDecoCount = 0;
-    static int g_shadowSizeEnum = InternalSettings::ShadowLarge;
-    static int g_shadowStrength = 255;
-    static QColor g_shadowColor = Qt::black;
-    static QSharedPointer<KDecoration2::DecorationShadow> g_sShadow;
-    static bool g_specificShadowsInactiveWindows = false;
-    static int g_shadowSizeEnumInactiveWindows = InternalSettings::ShadowLarge;
-    static int g_shadowStrengthInactiveWindows = 255;
-    static QColor g_shadowColorInactiveWindows = Qt::black;
 
     Decoration::Decoration(QObject *parent, const QVariantList &args)
         : KDecoration2::Decoration(parent, args)
         , m_animation( new QVariantAnimation( this ) )
+        , m_shadowAnimation( new QVariantAnimation( this ) )
     {
         g_sDecoCount++;
     }
@@ -190,8 +125,8 @@ namespace Breeze
     {
         g_sDecoCount--;
         if (g_sDecoCount == 0) {
-            // last deco destroyed, clean up shadow
-            g_sShadow.clear();
+            // last deco destroyed, clean up shadows
+            ShadowCache::self().clear();
         }
 
         deleteSizeGrip();
@@ -202,108 +137,135 @@ namespace Breeze
     {
         if( m_opacity == value ) return;
         m_opacity = value;
+        updatePalette();
         update();
 
         if( m_sizeGrip ) m_sizeGrip->update();
     }
 
-    QColor Decoration::titleBarColor() const
+    void Decoration::updateClientState()
     {
-        QColor titleBarColor( this->rawTitleBarColor() );
-        QColor outlineColor( this->outlineColor() );
-
-        auto c( client().toStrongRef().data() );
-        if ( outlineColor.isValid() && c->isActive() )
-        {
-            if ( qGray(titleBarColor.rgb()) > 69 )
-                titleBarColor = titleBarColor.darker(115);
-            else
-                titleBarColor = titleBarColor.lighter(115);
-        }
-        else if ( outlineColor.isValid() )
-        {
-            if ( qGray(titleBarColor.rgb()) > 69 )
-                titleBarColor = titleBarColor.darker(110);
-            else
-                titleBarColor = titleBarColor.lighter(110);
-        }
-        return titleBarColor;
-    }
-
-    QColor Decoration::outlineColor() const
-    {
-        QColor titleBarColor ( rawTitleBarColor() );
-
-        uint r = qRed(titleBarColor.rgb());
-        uint g = qGreen(titleBarColor.rgb());
-        uint b = qBlue(titleBarColor.rgb());
-
-        qreal colorConditional = 0.299 * static_cast<qreal>(r) + 0.587 * static_cast<qreal>(g) + 0.114 * static_cast<qreal>(b);
-
-        QColor outlineColor;
-        if ( colorConditional > 69 ) // 255 -186
-          outlineColor = titleBarColor.darker(140);
-        else
-          outlineColor = titleBarColor.lighter(140);
-
-        return outlineColor;
+        auto c = client().toStrongRef().data();
+        m_clientState.active = c->isActive();
+        m_clientState.maximized = c->isMaximized();
+        m_clientState.maximizedHorizontally = c->isMaximizedHorizontally();
+        m_clientState.maximizedVertically = c->isMaximizedVertically();
+        m_clientState.shaded = c->isShaded();
+        m_clientState.adjacentScreenEdges = c->adjacentScreenEdges();
+        m_clientState.caption = c->caption();
     }
 
-    QColor Decoration::rawTitleBarColor() const
+    void Decoration::updatePalette()
     {
         auto c = client().toStrongRef().data();
-        QColor titleBarColor;
+        const bool active = m_clientState.active;
+        const bool animated = m_animation->state() == QAbstractAnimation::Running;
+
+        ColorPalette palette;
+        palette.active = active;
 
+        // raw title bar
         if ( !matchColorForTitleBar() ) {
-            if( m_animation->state() == QAbstractAnimation::Running )
+            if( animated )
             {
-                titleBarColor = KColorUtils::mix(
+                palette.rawTitleBar = KColorUtils::mix(
                     c->color( ColorGroup::Inactive, ColorRole::TitleBar ),
                     c->color( ColorGroup::Active, ColorRole::TitleBar ),
                     m_opacity );
-            } else titleBarColor = c->color( c->isActive() ? ColorGroup::Active : ColorGroup::Inactive, ColorRole::TitleBar );
+            } else palette.rawTitleBar = c->color( active ? ColorGroup::Active : ColorGroup::Inactive, ColorRole::TitleBar );
         }
         else {
-          titleBarColor = c->palette().color(QPalette::Window);
-        }
-        return titleBarColor;
-    }
-
-    QColor Decoration::fontColor() const
-    {
-         auto c = client().toStrongRef().data();
-
-         if (systemForegroundColor()) {
-             if( m_animation->state() == QAbstractAnimation::Running ) {
-                 return KColorUtils::mix(
-                        c->color( ColorGroup::Inactive, ColorRole::Foreground ),
-                        c->color( ColorGroup::Active, ColorRole::Foreground ),
-                        m_opacity );
-             }
-             else {
-                 return  c->color( c->isActive() ? ColorGroup::Active : ColorGroup::Inactive, ColorRole::Foreground );
-             }
+          palette.rawTitleBar = c->palette().color(QPalette::Window);
         }
-        else {
-            QColor darkTextColor( !c->isActive() && matchColorForTitleBar() ? QColor(81, 102, 107) : QColor(34, 45, 50) );
-            QColor lightTextColor( !c->isActive() && matchColorForTitleBar() ? QColor(192, 193, 194) : QColor(250, 251, 252) );
 
-            QColor titleBarColor = this->titleBarColor();
+        // outline
+        {
+            const QColor &titleBarColor( palette.rawTitleBar );
 
             uint r = qRed(titleBarColor.rgb());
             uint g = qGreen(titleBarColor.rgb());
             uint b = qBlue(titleBarColor.rgb());
 
-            // modified from https://stackoverflow.com/questions/3942878/how-to-decide-font-color-in-white-or-black-depending-on-background-color
-            // qreal titleBarLuminance = (0.2126 * static_cast<qreal>(r) + 0.7152 * static_cast<qreal>(g) + 0.0722 * static_cast<qreal>(b)) / 255.;
-            // if ( titleBarLuminance >  sqrt(1.05 * 0.05) - 0.05 )
             qreal colorConditional = 0.299 * static_cast<qreal>(r) + 0.587 * static_cast<qreal>(g) + 0.114 * static_cast<qreal>(b);
-            if ( colorConditional > 186 || g > 186 ) // ( colorConditional > 186 ) // if ( colorConditional > 150 )
-                return darkTextColor;
+
+            if ( colorConditional > 69 ) // 255 -186
+              palette.outline = titleBarColor.darker(140);
+            else
+              palette.outline = titleBarColor.lighter(140);
+        }
+
+        // title bar
+        palette.titleBar = palette.rawTitleBar;
+        if ( palette.outline.isValid() && active )
+        {
+            if ( qGray(palette.titleBar.rgb()) > 69 )
+                palette.titleBar = palette.titleBar.darker(115);
+            else
+                palette.titleBar = palette.titleBar.lighter(115);
+        }
+        else if ( palette.outline.isValid() )
+        {
+            if ( qGray(palette.titleBar.rgb()) > 69 )
+                palette.titleBar = palette.titleBar.darker(110);
             else
-                return lightTextColor;
+                palette.titleBar = palette.titleBar.lighter(110);
         }
 
+        // modified from https://stackoverflow.com/questions/3942878/how-to-decide-font-color-in-white-or-black-depending-on-background-color
+        // qreal titleBarLuminance = (0.2126 * static_cast<qreal>(r) + 0.7152 * static_cast<qreal>(g) + 0.0722 * static_cast<qreal>(b)) / 255.;
+        // if ( titleBarLuminance >  sqrt(1.05 * 0.05) - 0.05 )
+        const int g = qGreen(palette.titleBar.rgb());
+        const qreal colorConditional = 0.299 * static_cast<qreal>(qRed(palette.titleBar.rgb())) + 0.587 * static_cast<qreal>(g) + 0.114 * static_cast<qreal>(qBlue(palette.titleBar.rgb()));
+        const bool lightTitleBar = colorConditional > 186 || g > 186; // ( colorConditional > 186 ) // if ( colorConditional > 150 )
+
+        // font
+        if (systemForegroundColor()) {
+            if( animated ) {
+                palette.font = KColorUtils::mix(
+                    c->color( ColorGroup::Inactive, ColorRole::Foreground ),
+                    c->color( ColorGroup::Active, ColorRole::Foreground ),
+                    m_opacity );
+            }
+            else {
+                palette.font = c->color( active ? ColorGroup::Active : ColorGroup::Inactive, ColorRole::Foreground );
+            }
+        }
+        else {
+            QColor darkTextColor( !active && matchColorForTitleBar() ? QColor(81, 102, 107) : QColor(34, 45, 50) );
+            QColor lightTextColor( !active && matchColorForTitleBar() ? QColor(192, 193, 194) : QColor(250, 251, 252) );
+            palette.font = lightTitleBar ? darkTextColor : lightTextColor;
+        }
+
+        // button symbols
+        const QColor darkSymbolColor( ( !active && matchColorForTitleBar() ) ? QColor(250, 251, 252) : QColor(34, 45, 50) );
+        const QColor lightSymbolColor( ( !active && matchColorForTitleBar() ) ? QColor(192, 193, 194) : QColor(250, 251, 252) );
+        palette.symbol = darkSymbolColor;
+        if( systemForegroundColor() ) palette.menuSymbol = palette.font;
+        else palette.menuSymbol = lightTitleBar ? darkSymbolColor : lightSymbolColor;
+
+        // button orbs, each type has its own color on active windows, all of them are grey on inactive ones
+        const int titlebarColorGrayness = qGray(palette.titleBar.rgb());
+        auto setButtonColor = [&]( KDecoration2::DecorationButtonType type, const QColor &darkTitleBarColor, const QColor &lightTitleBarColor )
+        {
+            QColor button_color;
+            if( !active ) button_color = titlebarColorGrayness < 128 ? QColor(100, 100, 100) : QColor(200, 200, 200);
+            else button_color = titlebarColorGrayness < 128 ? darkTitleBarColor : lightTitleBarColor;
+
+            const int index = static_cast<int>( type );
+            palette.buttonBackgrounds[index] = button_color;
+            palette.buttonBorders[index] = titlebarColorGrayness < 69 ? button_color.lighter(115) : button_color.darker(115);
+        };
+
+        setButtonColor( KDecoration2::DecorationButtonType::Close, QColor(238, 102, 90), QColor(255, 97, 89) );
+        setButtonColor( KDecoration2::DecorationButtonType::Maximize, QColor(100, 196, 86), QColor(41, 204, 65) );
+        setButtonColor( KDecoration2::DecorationButtonType::Minimize, QColor(223, 192, 76), QColor(255, 193, 46) );
+        setButtonColor( KDecoration2::DecorationButtonType::OnAllDesktops, QColor(125, 209, 200), QColor(125, 209, 200) );
+        setButtonColor( KDecoration2::DecorationButtonType::Shade, QColor(204, 176, 213), QColor(204, 176, 213) );
+        setButtonColor( KDecoration2::DecorationButtonType::KeepBelow, QColor(255, 137, 241), QColor(255, 137, 241) );
+        setButtonColor( KDecoration2::DecorationButtonType::KeepAbove, QColor(135, 206, 249), QColor(135, 206, 249) );
+        setButtonColor( KDecoration2::DecorationButtonType::ContextHelp, QColor(102, 156, 246), QColor(102, 156, 246) );
+
+        m_palette = palette;
     }
 
     void Decoration::setButtonHovered( bool value )
@@ -329,6 +291,18 @@ namespace Breeze
     {
         auto c = client().toStrongRef().data();
 
+        // client state snapshot, connected before anything else, including the size grip
+        // created by reconfigure, so that all other slots see the new state
+        connect(c, &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::updateClientState);
+        connect(c, &KDecoration2::DecoratedClient::maximizedChanged, this, &Decoration::updateClientState);
+        connect(c, &KDecoration2::DecoratedClient::maximizedHorizontallyChanged, this, &Decoration::updateClientState);
+        connect(c, &KDecoration2::DecoratedClient::maximizedVerticallyChanged, this, &Decoration::updateClientState);
+        connect(c, &KDecoration2::DecoratedClient::shadedChanged, this, &Decoration::updateClientState);
+        connect(c, &KDecoration2::DecoratedClient::adjacentScreenEdgesChanged, this, &Decoration::updateClientState);
+        connect(c, &KDecoration2::DecoratedClient::captionChanged, this, &Decoration::updateClientState);
+
+        updateClientState();
+
         // active state change animation
         // It is important start and end value are of the same type, hence 0.0 and not just 0
         m_animation->setStartValue( 0.0 );
@@ -339,6 +313,19 @@ namespace Breeze
             setOpacity(value.toReal());
         });
 
+        // shadow transition on focus change, a blended frame is only uploaded when the step changes,
+        // not on every tick of the animation. Duration comes with the settings, in reconfigure
+        m_shadowAnimation->setStartValue( 0 );
+        m_shadowAnimation->setEndValue( int( Metrics::Shadow_TransitionSteps ) );
+        m_shadowAnimation->setEasingCurve( QEasingCurve::Linear );
+        connect(m_shadowAnimation, &QVariantAnimation::valueChanged, this, [this](const QVariant &value) {
+            const int step = value.toInt();
+            if( !m_shadowCrossFade || step == m_shadowTransitionStep || step >= Metrics::Shadow_TransitionSteps ) return;
+            m_shadowTransitionStep = step;
+            m_transitionShadow->setShadow( m_shadowCrossFade->frame( qreal( step )/Metrics::Shadow_TransitionSteps ) );
+        });
+        connect(m_shadowAnimation, &QVariantAnimation::finished, this, &Decoration::updateShadow);
+
         reconfigure();
         updateTitleBar();
         auto s = settings();
@@ -368,13 +355,15 @@ namespace Breeze
         connect(c, &KDecoration2::DecoratedClient::captionChanged, this,
             [this]()
             {
-                // update the caption area
-                update(titleBar());
+                // update the caption area, where the previous caption was and where the new one goes
+                update( m_paintedCaptionRect | captionRect().first );
             }
         );
 
+        connect(c, &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::updatePalette);
+        connect(c, &KDecoration2::DecoratedClient::paletteChanged, this, &Decoration::updatePalette);
         connect(c, &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::updateAnimationState);
-        connect(c, &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::createShadow);
+        connect(c, &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::crossFadeShadow);
         connect(c, &KDecoration2::DecoratedClient::activeChanged, this, &Decoration::updateBlur);
         connect(c, &KDecoration2::DecoratedClient::widthChanged, this, &Decoration::updateTitleBar);
         connect(c, &KDecoration2::DecoratedClient::maximizedChanged, this, &Decoration::updateTitleBar);
@@ -409,49 +398,102 @@ namespace Breeze
 
     void Decoration::updateShadow()
     {
-        auto c = client().toStrongRef().data();
+        // both shadows are resident, so a focus change only swaps the shadow object
+        // and the compositor can keep the textures it has already uploaded
+        m_shadowAnimation->stop();
+        m_shadowCrossFade.reset();
+        m_transitionShadow.clear();
 
-        if ( !g_specificShadowsInactiveWindows || c->isActive() )
-          updateActiveShadow();
-        else
-          updateInactiveShadow();
+        setShadow( m_clientState.active ? m_activeShadow : m_inactiveShadow );
     }
 
-    void Decoration::updateActiveShadow() {
+    void Decoration::crossFadeShadow()
+    {
+        if( !m_internalSettings->shadowTransition() || m_internalSettings->shadowTransitionDuration() <= 0 )
+        {
+            updateShadow();
+            return;
+        }
+
+        const auto target = m_clientState.active ? m_activeShadow : m_inactiveShadow;
 
-        CompositeShadowParams params;
-        params = lookupShadowParams(g_shadowSizeEnum);
+        // start from whatever is shown, which is a blended frame when focus changes mid-transition
+        const auto current = shadow();
+        if( !current || !target || current == target )
+        {
+            updateShadow();
+            return;
+        }
 
-        if ( params.isNone() ) {
-          g_sShadow.clear();
-          setShadow(g_sShadow);
-          return;
+        std::unique_ptr<ShadowCrossFade> crossFade( new ShadowCrossFade( current, target ) );
+        if( !crossFade->isValid() )
+        {
+            updateShadow();
+            return;
         }
 
+        m_shadowAnimation->stop();
+        m_shadowCrossFade = std::move( crossFade );
+        m_shadowTransitionStep = 0;
+
+        m_transitionShadow = QSharedPointer<KDecoration2::DecorationShadow>::create();
+        m_transitionShadow->setPadding( m_shadowCrossFade->padding() );
+        m_transitionShadow->setInnerShadowRect( m_shadowCrossFade->innerShadowRect() );
+        m_transitionShadow->setShadow( m_shadowCrossFade->frame( 0 ) );
+        setShadow( m_transitionShadow );
+
+        m_shadowAnimation->start();
+    }
+
+    //* render the shadow texture for given parameters, runs on a worker thread
+    static ShadowCache::Texture renderShadow(const CompositeShadowParams &params, const ShadowCacheKey &key)
+    {
         auto withOpacity = [](const QColor &color, qreal opacity) -> QColor {
           QColor c(color);
           c.setAlphaF(opacity);
           return c;
         };
 
-        const auto s = settings();
+        const qreal borderRadius = 0.5*key.smallSpacing*(key.cornerRadius + 0.5);
 
-        const QSize boxSize = BoxShadowRenderer::calculateMinimumBoxSize(2*s->smallSpacing()*params.shadow1.radius)
-        .expandedTo(BoxShadowRenderer::calculateMinimumBoxSize(2*s->smallSpacing()*params.shadow2.radius));
+        // nine-slice texture
+        const QSize boxSize = params.boxSize(borderRadius);
+
+        // placeholders are blurred at a fraction of the scale, which takes a fraction of the time
+        const qreal devicePixelRatio = key.placeholder ? key.devicePixelRatio/Metrics::Shadow_PlaceholderDownscale : key.devicePixelRatio;
 
         BoxShadowRenderer shadowRenderer;
-        shadowRenderer.setBorderRadius(0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() + 0.5));
+        shadowRenderer.setBorderRadius(borderRadius);
         shadowRenderer.setBoxSize(boxSize);
-        shadowRenderer.setDevicePixelRatio(1.0); // TODO: Create HiDPI shadows?
+        shadowRenderer.setDevicePixelRatio(devicePixelRatio);
+        shadowRenderer.setMethod(BoxShadowRenderer::Method::Automatic);
 
-        const qreal strength = static_cast<qreal>(g_shadowStrength) / 255.0;
+        const qreal strength = static_cast<qreal>(key.strength) / 255.0;
         shadowRenderer.addShadow(params.shadow1.offset, params.shadow1.radius,
-            withOpacity(g_shadowColor, params.shadow1.opacity * strength));
+            withOpacity(key.color, params.shadow1.opacity * strength));
         shadowRenderer.addShadow(params.shadow2.offset, params.shadow2.radius,
-            withOpacity(g_shadowColor, params.shadow2.opacity * strength));
+            withOpacity(key.color, params.shadow2.opacity * strength));
 
         QImage shadowTexture = shadowRenderer.render();
 
+        if( key.placeholder )
+        {
+            // upscaled to the geometry of the real shadow, so that both have the same padding
+            const QSize canvasSize = BoxShadowRenderer::calculateMinimumShadowTextureSize(boxSize, params.shadow1.radius, params.shadow1.offset)
+                .expandedTo(BoxShadowRenderer::calculateMinimumShadowTextureSize(boxSize, params.shadow2.radius, params.shadow2.offset));
+
+            QImage upscaled(canvasSize*key.devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+            upscaled.setDevicePixelRatio(key.devicePixelRatio);
+            upscaled.fill(Qt::transparent);
+
+            QPainter painter(&upscaled);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform);
+            painter.drawImage(QRect(QPoint(0, 0), canvasSize), shadowTexture);
+            painter.end();
+
+            shadowTexture = upscaled;
+        }
+
         QPainter painter(&shadowTexture);
         painter.setRenderHint(QPainter::Antialiasing);
 
@@ -471,113 +513,74 @@ namespace Breeze
         painter.setPen(Qt::NoPen);
         painter.setBrush(Qt::black);
         painter.setCompositionMode(QPainter::CompositionMode_DestinationOut);
-        painter.drawRoundedRect(
-            innerRect,
-            0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() + 0.5),
-            0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() + 0.5));
+        painter.drawRoundedRect(innerRect, borderRadius, borderRadius);
 
         // Draw outline.
-        // painter.setPen(withOpacity(g_shadowColor, 0.2 * strength));
+        // painter.setPen(withOpacity(key.color, 0.2 * strength));
         // painter.setBrush(Qt::NoBrush);
         // painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
         // painter.drawRoundedRect(
         //     innerRect,
-        //     0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() - 0.5),
-        //     0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() - 0.5));
+        //     0.5*key.smallSpacing*(key.cornerRadius - 0.5),
+        //     0.5*key.smallSpacing*(key.cornerRadius - 0.5));
 
         painter.end();
 
-        g_sShadow = QSharedPointer<KDecoration2::DecorationShadow>::create();
-        g_sShadow->setPadding(padding);
-        g_sShadow->setInnerShadowRect(QRect(outerRect.center(), QSize(1, 1)));
-        g_sShadow->setShadow(shadowTexture);
+        ShadowCache::Texture texture;
+        texture.image = shadowTexture;
+        texture.padding = padding;
+        texture.innerShadowRect = QRect(outerRect.center(), QSize(1, 1));
 
-        setShadow(g_sShadow);
+        return texture;
     }
 
-    void Decoration::updateInactiveShadow() {
-
-        CompositeShadowParams params;
-        params = lookupShadowParamsInactiveWindows(g_shadowSizeEnumInactiveWindows);
-
-        if ( params.isNone() ) {
-          g_sShadow.clear();
-          setShadow(g_sShadow);
-          return;
-        }
-
-        auto withOpacity = [](const QColor &color, qreal opacity) -> QColor {
-          QColor c(color);
-          c.setAlphaF(opacity);
-          return c;
-        };
+    QSharedPointer<KDecoration2::DecorationShadow> Decoration::cachedShadow(int sizeIndex, int shadowStrength, const QColor &shadowColor,
+        const QSharedPointer<KDecoration2::DecorationShadow> &placeholder)
+    {
+        const CompositeShadowParams params = s_shadowParams[sizeIndex];
+        if ( params.isNone() ) return {};
 
         const auto s = settings();
 
-        const QSize boxSize = BoxShadowRenderer::calculateMinimumBoxSize(2*s->smallSpacing()*params.shadow1.radius)
-        .expandedTo(BoxShadowRenderer::calculateMinimumBoxSize(2*s->smallSpacing()*params.shadow2.radius));
-
-        BoxShadowRenderer shadowRenderer;
-        shadowRenderer.setBorderRadius(0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() + 0.5));
-        shadowRenderer.setBoxSize(boxSize);
-        shadowRenderer.setDevicePixelRatio(1.0); // TODO: Create HiDPI shadows?
-
-        const qreal strength = static_cast<qreal>(g_shadowStrengthInactiveWindows) / 255.0;
-        shadowRenderer.addShadow(params.shadow1.offset, params.shadow1.radius,
-            withOpacity(g_shadowColorInactiveWindows, params.shadow1.opacity * strength));
-        shadowRenderer.addShadow(params.shadow2.offset, params.shadow2.radius,
-            withOpacity(g_shadowColorInactiveWindows, params.shadow2.opacity * strength));
-
-        QImage shadowTexture = shadowRenderer.render();
-
-        QPainter painter(&shadowTexture);
-        painter.setRenderHint(QPainter::Antialiasing);
-
-        const QRect outerRect = shadowTexture.rect();
-
-        QRect boxRect(QPoint(0, 0), boxSize);
-        boxRect.moveCenter(outerRect.center());
-
-        // Mask out inner rect.
-        const QMargins padding = QMargins(
-            boxRect.left() - outerRect.left() - Metrics::Shadow_Overlap - params.offset.x(),
-            boxRect.top() - outerRect.top() - Metrics::Shadow_Overlap - params.offset.y(),
-            outerRect.right() - boxRect.right() - Metrics::Shadow_Overlap + params.offset.x(),
-            outerRect.bottom() - boxRect.bottom() - Metrics::Shadow_Overlap + params.offset.y());
-        const QRect innerRect = outerRect - padding;
-
-        painter.setPen(Qt::NoPen);
-        painter.setBrush(Qt::black);
-        painter.setCompositionMode(QPainter::CompositionMode_DestinationOut);
-        painter.drawRoundedRect(
-            innerRect,
-            0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() + 0.5),
-            0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() + 0.5));
-
-        // Draw outline.
-        // painter.setPen(withOpacity(g_shadowColorInactiveWindows, 0.2 * strength));
-        // painter.setBrush(Qt::NoBrush);
-        // painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        // painter.drawRoundedRect(
-        //     innerRect,
-        //     0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() - 0.5),
-        //     0.5*s->smallSpacing()*(m_internalSettings->cornerRadius() - 0.5));
+        ShadowCacheKey key;
+        key.size = sizeIndex;
+        key.strength = shadowStrength;
+        key.color = shadowColor;
+        key.cornerRadius = m_internalSettings->cornerRadius();
+        key.smallSpacing = s->smallSpacing();
+        // Pinned on purpose: KWin 5 ignores the device pixel ratio of DecorationShadow textures and
+        // maps them pixel for pixel onto logical coordinates, like the padding and the inner shadow rect,
+        // so a texture rendered at the output scale comes out larger instead of sharper.
+        // Same as upstream Breeze, shadows are rendered at a scale of 1. The device pixel ratio of the
+        // key and of BoxShadowRenderer are only there for when KWin takes scaled shadow textures.
+        key.devicePixelRatio = 1.0;
+
+        const auto factory = [params, key]() {
+            return renderShadow(params, key);
+        };
 
-        painter.end();
+        const auto shadow = ShadowCache::self().shadow(key, factory, this, [this]() {
+            createShadow();
+        });
+        if( shadow ) return shadow;
 
-        g_sShadow = QSharedPointer<KDecoration2::DecorationShadow>::create();
-        g_sShadow->setPadding(padding);
-        g_sShadow->setInnerShadowRect(QRect(outerRect.center(), QSize(1, 1)));
-        g_sShadow->setShadow(shadowTexture);
+        // keep showing the previous shadow until the new one is rendered
+        if( placeholder ) return placeholder;
 
-        setShadow(g_sShadow);
+        // the first shadow of a window is needed before it is mapped, a cheap stand-in
+        // is shown until the real one is rendered in the background
+        ShadowCacheKey placeholderKey = key;
+        placeholderKey.placeholder = true;
+        return ShadowCache::self().shadow(placeholderKey, [params, placeholderKey]() {
+            return renderShadow(params, placeholderKey);
+        });
     }
 
     void Decoration::updateSizeGripVisibility()
     {
         auto c = client().toStrongRef().data();
         if( m_sizeGrip )
-        { m_sizeGrip->setVisible( c->isResizeable() && !isMaximized() && !c->isShaded() ); }
+        { m_sizeGrip->setVisible( c->isResizeable() && !isMaximized() && !m_clientState.shaded ); }
     }
 
     int Decoration::borderSize(bool bottom) const
@@ -620,12 +623,16 @@ namespace Breeze
 
         m_internalSettings = SettingsProvider::self()->internalSettings( this );
 
+        // colors depend on the title bar and foreground settings
+        updatePalette();
+
         // borders
         recalculateBorders();
 
         updateBlur();
 
         // shadow
+        m_shadowAnimation->setDuration( m_internalSettings->shadowTransitionDuration() );
         createShadow();
 
         // size grip
@@ -636,13 +643,12 @@ namespace Breeze
 
     void Decoration::recalculateBorders()
     {
-        auto c = client().toStrongRef().data();
         auto s = settings();
 
         // left, right and bottom borders
         const int left   = isLeftEdge() ? 0 : borderSize();
         const int right  = isRightEdge() ? 0 : borderSize();
-        const int bottom = (c->isShaded() || isBottomEdge()) ? 0 : borderSize(true);
+        const int bottom = (m_clientState.shaded || isBottomEdge()) ? 0 : borderSize(true);
 
         int top = 0;
         if( hideTitleBar() ) top = bottom;
@@ -685,12 +691,8 @@ namespace Breeze
 
     void Decoration::updateBlur()
     {
-        // access client
-        auto c = client().toStrongRef();
-        Q_ASSERT(c);
-
         //disable blur if the titlebar is opaque
-        if( (c->isMaximized() )
+        if( (m_clientState.maximized )
             || ( m_opacity == 100 && this->titleBarColor().alpha() == 255 )
         ){ //opaque titlebar colours
             setBlurRegion( QRegion() );
@@ -703,11 +705,9 @@ namespace Breeze
 
     void Decoration::calculateWindowAndTitleBarShapes(const bool windowShapeOnly)
     {
-        auto c = client().toStrongRef();
-        Q_ASSERT(c);
         auto s = settings();
         
-        if( !windowShapeOnly || c->isShaded() )
+        if( !windowShapeOnly || m_clientState.shaded )
         {
             //set titleBar geometry and path
             m_titleRect = QRect(QPoint(0, 0), QSize(size().width(), borderTop()));
@@ -716,7 +716,7 @@ namespace Breeze
             {
                 m_titleBarPath->addRect(m_titleRect);
 
-            } else if( c->isShaded() ) {
+            } else if( m_clientState.shaded ) {
                 m_titleBarPath->addRoundedRect(m_titleRect, 0.5*s->smallSpacing()*m_internalSettings->cornerRadius(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius());
 
             } else {
@@ -737,7 +737,7 @@ namespace Breeze
         
         //set windowPath
         m_windowPath->clear(); //clear the path for subsequent calls to this function
-        if( !c->isShaded() )
+        if( !m_clientState.shaded )
         {
             if( s->isAlphaChannelSupported() && !isMaximized() ) m_windowPath->addRoundedRect(rect(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius());
             else m_windowPath->addRect( rect() );
@@ -814,22 +814,188 @@ namespace Breeze
 
     void Decoration::paint(QPainter *painter, const QRect &repaintRegion)
     {
-        // TODO: optimize based on repaintRegion
-        auto c = client().toStrongRef().data();
+        const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+
+        // nothing outside the damaged area is drawn, a hovered button only costs its own rect
+        const QRect damagedRect = repaintRegion & rect();
+        if( damagedRect.isEmpty() ) return;
+
+        // frame, border and title bar background only change with colors and settings, and along the edges
+        // they only repeat. They are rasterized once as a nine-slice layer: the title bar strip, the border strips
+        // and the four corners, with a few rows and columns in between of which one is stretched over the window
+        const QMargins slices = backgroundSlices();
+        const QSize layerSize(
+            backgroundLayerSize( size().width(), slices.left(), slices.right(), devicePixelRatio ),
+            backgroundLayerSize( size().height(), slices.top(), slices.bottom(), devicePixelRatio ) );
+
+        const BackgroundKey key = backgroundKey( layerSize, devicePixelRatio );
+        if( !( key == m_backgroundKey ) )
+        {
+            m_backgroundKey = key;
+            m_background = QImage( layerSize*devicePixelRatio, QImage::Format_ARGB32_Premultiplied );
+            m_background.setDevicePixelRatio( devicePixelRatio );
+            m_background.fill( Qt::transparent );
+
+            if( !m_background.isNull() )
+            {
+                QPainter backgroundPainter( &m_background );
+                paintBackground( &backgroundPainter, layerSize );
+            }
+        }
+
+        // blit the damaged part of every slice, in device pixels so that blits are never resampled
+        const QRect deviceDamage(
+            QPoint( std::floor( damagedRect.left()*devicePixelRatio ), std::floor( damagedRect.top()*devicePixelRatio ) ),
+            QPoint( std::ceil( ( damagedRect.right() + 1 )*devicePixelRatio ) - 1, std::ceil( ( damagedRect.bottom() + 1 )*devicePixelRatio ) - 1 ) );
+
+        BackgroundSlice columns[3];
+        BackgroundSlice rows[3];
+        const int columnCount = backgroundSlices( size().width(), layerSize.width(), slices.left(), slices.right(), devicePixelRatio, columns );
+        const int rowCount = backgroundSlices( size().height(), layerSize.height(), slices.top(), slices.bottom(), devicePixelRatio, rows );
+        for( int row = 0; row < rowCount; ++row )
+        {
+            for( int column = 0; column < columnCount; ++column )
+            {
+                const BackgroundSlice &x = columns[column];
+                const BackgroundSlice &y = rows[row];
+                const QRect target = QRect( x.begin, y.begin, x.end - x.begin, y.end - y.begin ) & deviceDamage;
+                if( target.isEmpty() ) continue;
+
+                const QRect source(
+                    x.stretch ? x.source : x.source + target.left() - x.begin,
+                    y.stretch ? y.source : y.source + target.top() - y.begin,
+                    x.stretch ? 1 : target.width(),
+                    y.stretch ? 1 : target.height() );
+                painter->drawImage( QRectF( QPointF( target.topLeft() )/devicePixelRatio, QSizeF( target.size() )/devicePixelRatio ),
+                    m_background, source );
+            }
+        }
+
+        // the foreground is clipped too, antialiased edges outside the damaged area are already there
+        // and would only get darker when painted again over themselves
+        painter->save();
+        painter->setClipRect( damagedRect, Qt::IntersectClip );
+        paintTitleBar(painter, damagedRect);
+
+        // the border outline goes over the buttons, so it is not part of the background layer
+        if ( hasBorders() )
+        {
+            auto s = settings();
+
+            // painter->setRenderHint(QPainter::Antialiasing, false);
+            painter->setBrush( Qt::NoBrush );
+
+            QPen border_pen1( titleBarColor().darker( 125 ) );
+            painter->setPen(border_pen1);
+            if( s->isAlphaChannelSupported() )
+              painter->drawRoundedRect(rect(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius());
+            else
+              painter->drawRect( rect() );
+        }
+
+        painter->restore();
+    }
+
+    bool Decoration::BackgroundKey::operator==( const BackgroundKey& other ) const
+    {
+        return size == other.size
+            && devicePixelRatio == other.devicePixelRatio
+            && titleBarColor == other.titleBarColor
+            && outlineColor == other.outlineColor
+            && cornerRadius == other.cornerRadius
+            && smallSpacing == other.smallSpacing
+            && borderSize == other.borderSize
+            && borderTop == other.borderTop
+            && hasBorders == other.hasBorders
+            && alphaChannelSupported == other.alphaChannelSupported
+            && shaded == other.shaded
+            && hideTitleBar == other.hideTitleBar
+            && edges == other.edges;
+    }
+
+    QMargins Decoration::backgroundSlices() const
+    {
+        // the rounded corners of the frame and of the title bar, and the borders, with some room for antialiasing
+        const int cornerRadius = m_internalSettings->cornerRadius();
+        const int frameRadius = std::ceil( 0.5*settings()->smallSpacing()*cornerRadius );
+        const int extent = qMax( qMax( frameRadius, cornerRadius ), borderSize() ) + 2;
+
+        // the title bar has no row that repeats
+        return QMargins( extent, qMax( borderTop(), extent ), extent, extent );
+    }
+
+    int Decoration::backgroundLayerSize( int size, int begin, int end, qreal devicePixelRatio )
+    {
+        // a few pixels in between, so that at least one device pixel column repeats at fractional scales.
+        // The layer must also be a whole number of device pixels smaller than the decoration, or the
+        // antialiasing of its end corners would not match
+        const int minimumSize = begin + end + 3;
+        for( int layerSize = minimumSize; layerSize < qMin( size, minimumSize + 8 ); ++layerSize )
+        {
+            const qreal offset = ( size - layerSize )*devicePixelRatio;
+            if( std::abs( offset - std::round( offset ) ) < 1e-6 ) return layerSize;
+        }
+
+        // too small for the layer to repeat anything, or no such size, it has the full size
+        return size;
+    }
+
+    int Decoration::backgroundSlices( int size, int layerSize, int begin, int end, qreal devicePixelRatio, BackgroundSlice *slices )
+    {
+        const int deviceSize = qRound( size*devicePixelRatio );
+        if( layerSize >= size )
+        {
+            slices[0] = { 0, deviceSize, 0, false };
+            return 1;
+        }
+
+        const int deviceLayerSize = qRound( layerSize*devicePixelRatio );
+        const int deviceBegin = std::ceil( begin*devicePixelRatio );
+        const int deviceEnd = std::ceil( end*devicePixelRatio );
+        slices[0] = { 0, deviceBegin, 0, false };
+        slices[1] = { deviceBegin, deviceSize - deviceEnd, deviceBegin, true };
+        slices[2] = { deviceSize - deviceEnd, deviceSize, deviceLayerSize - deviceEnd, false };
+        return 3;
+    }
+
+    Decoration::BackgroundKey Decoration::backgroundKey( const QSize &layerSize, qreal devicePixelRatio ) const
+    {
+        BackgroundKey key;
+        key.size = layerSize;
+        key.devicePixelRatio = devicePixelRatio;
+        key.titleBarColor = titleBarColor();
+        key.outlineColor = outlineColor();
+        key.cornerRadius = m_internalSettings->cornerRadius();
+        key.smallSpacing = settings()->smallSpacing();
+        key.borderSize = borderSize();
+        key.borderTop = borderTop();
+        key.hasBorders = hasBorders();
+        key.alphaChannelSupported = settings()->isAlphaChannelSupported();
+        key.shaded = m_clientState.shaded;
+        key.hideTitleBar = hideTitleBar();
+        if( isLeftEdge() ) key.edges |= Qt::LeftEdge;
+        if( isRightEdge() ) key.edges |= Qt::RightEdge;
+        if( isTopEdge() ) key.edges |= Qt::TopEdge;
+        if( isBottomEdge() ) key.edges |= Qt::BottomEdge;
+        return key;
+    }
+
+    void Decoration::paintBackground(QPainter *painter, const QSize &size) const
+    {
         auto s = settings();
+        const QRect rect( QPoint( 0, 0 ), size );
 
         QColor titleBarColor = this->titleBarColor();
 
         // paint background
-        if( !c->isShaded() )
+        if( !m_clientState.shaded )
         {
-            painter->fillRect(rect(), Qt::transparent);
             painter->save();
             painter->setRenderHint(QPainter::Antialiasing);
             painter->setBrush( titleBarColor );
 
             // clip away the top part
-            if( !hideTitleBar() ) painter->setClipRect(0, borderTop(), size().width(), size().height() - borderTop(), Qt::IntersectClip);
+            if( !hideTitleBar() ) painter->setClipRect(0, borderTop(), size.width(), size.height() - borderTop(), Qt::IntersectClip);
 
             // When no borders set, outline will be drawn by shader
             QPen border_pen1;
@@ -840,40 +1006,22 @@ namespace Breeze
 
             painter->setPen(border_pen1);
             if( s->isAlphaChannelSupported() ) {
-                painter->drawRoundedRect(rect(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius());
+                painter->drawRoundedRect(rect, 0.5*s->smallSpacing()*m_internalSettings->cornerRadius(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius());
             } else {
-                painter->drawRect( rect() );
+                painter->drawRect( rect );
             }
 
             painter->restore();
         }
 
-        paintTitleBar(painter, repaintRegion);
-
-        if ( hasBorders() )
-        {
-            painter->save();
-            // painter->setRenderHint(QPainter::Antialiasing, false);
-            painter->setBrush( Qt::NoBrush );
-
-            QPen border_pen1( titleBarColor.darker( 125 ) );
-            painter->setPen(border_pen1);
-            if( s->isAlphaChannelSupported() )
-              painter->drawRoundedRect(rect(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius(), 0.5*s->smallSpacing()*m_internalSettings->cornerRadius());
-            else
-              painter->drawRect( rect() );
-
-            painter->restore();
-        }
+        paintTitleBarBackground(painter, size);
 
     }
 
-    void Decoration::paintTitleBar(QPainter *painter, const QRect &repaintRegion)
+    void Decoration::paintTitleBarBackground(QPainter *painter, const QSize &size) const
     {
-        const QRect titleRect(QPoint(0, 0), QSize(size().width(), borderTop()));
-        if ( !titleRect.intersects(repaintRegion) ) return;
+        const QRect titleRect(QPoint(0, 0), QSize(size.width(), borderTop()));
 
-        auto c = client().toStrongRef().data();
         QColor outlineColor( this->outlineColor() );
         QColor titleBarColor = this->titleBarColor();
 
@@ -901,7 +1049,7 @@ namespace Breeze
             painter->drawRoundedRect(titleRect, m_internalSettings->cornerRadius(), m_internalSettings->cornerRadius());
         }
 
-        if( !c->isShaded() && !hideTitleBar() && outlineColor.isValid() )
+        if( !m_clientState.shaded && !hideTitleBar() && outlineColor.isValid() )
         {
             // outline
             painter->setRenderHint( QPainter::Antialiasing, false );
@@ -913,6 +1061,14 @@ namespace Breeze
         }
 
         painter->restore();
+    }
+
+    void Decoration::paintTitleBar(QPainter *painter, const QRect &repaintRegion)
+    {
+        const QRect titleRect(QPoint(0, 0), QSize(size().width(), borderTop()));
+        if ( !titleRect.intersects(repaintRegion) ) return;
+
+        auto s = settings();
 
         if( !hideTitleBar() ) {
           // draw all buttons
@@ -920,14 +1076,48 @@ namespace Breeze
           m_rightButtons->paint(painter, repaintRegion);
 
           // draw caption
+          const auto cR = captionRect();
+          if( !cR.first.intersects( repaintRegion ) ) return;
 
           painter->setFont(s->font());
           painter->setPen( fontColor() );
 
-          const auto cR = captionRect();
-          const QString caption = painter->fontMetrics().elidedText(c->caption(), Qt::ElideMiddle, cR.first.width());
-          painter->drawText(cR.first, cR.second | Qt::TextSingleLine, caption);
+          const QStaticText &caption = captionText( painter, cR.first.width() );
+
+          // same placement as drawText with the rect and alignment
+          const QSizeF textSize = caption.size();
+          qreal x = cR.first.left();
+          if( cR.second & Qt::AlignRight ) x = cR.first.left() + cR.first.width() - textSize.width();
+          else if( cR.second & Qt::AlignHCenter ) x = cR.first.left() + 0.5*( cR.first.width() - textSize.width() );
+          const qreal y = cR.first.top() + 0.5*( cR.first.height() - textSize.height() );
+
+          painter->drawStaticText( QPointF( x, y ), caption );
+          m_paintedCaptionRect = cR.first;
+        }
+    }
+
+    void Decoration::updateCaptionLayout( const QFont &font ) const
+    {
+        const QString &caption = m_clientState.caption;
+        if( caption == m_captionLayout.caption && font == m_captionLayout.font ) return;
+
+        m_captionLayout = CaptionLayout();
+        m_captionLayout.caption = caption;
+        m_captionLayout.font = font;
+    }
+
+    const QStaticText &Decoration::captionText( QPainter *painter, int width )
+    {
+        updateCaptionLayout( painter->font() );
+        if( m_captionLayout.width != width )
+        {
+            m_captionLayout.width = width;
+            m_captionLayout.text.setTextFormat( Qt::PlainText );
+            m_captionLayout.text.setText( painter->fontMetrics().elidedText( m_captionLayout.caption, Qt::ElideMiddle, width ) );
+            m_captionLayout.text.prepare( QTransform(), painter->font() );
         }
+
+        return m_captionLayout.text;
     }
 
     int Decoration::buttonHeight() const
@@ -955,7 +1145,6 @@ namespace Breeze
         else {
 
             auto s = settings();
-            auto c = client().toStrongRef().data();
             const int leftOffset = m_leftButtons->buttons().isEmpty() ?
                 Metrics::TitleBar_SideMargin*settings()->smallSpacing() + 0.5*s->smallSpacing()*m_internalSettings->buttonPadding() + 0.5*s->smallSpacing() :
                 m_leftButtons->geometry().x() + m_leftButtons->geometry().width() + Metrics::TitleBar_SideMargin*settings()->smallSpacing() + 0.5*s->smallSpacing()*m_internalSettings->buttonPadding() ;
@@ -984,7 +1173,13 @@ namespace Breeze
 
                     // full caption rect
                     const QRect fullRect = QRect( 0, yOffset, size().width(), captionHeight() );
-                    QRect boundingRect( settings()->fontMetrics().boundingRect( c->caption()).toRect() );
+                    updateCaptionLayout( s->font() );
+                    if( !m_captionLayout.boundingRectValid )
+                    {
+                        m_captionLayout.boundingRect = settings()->fontMetrics().boundingRect( m_captionLayout.caption ).toRect();
+                        m_captionLayout.boundingRectValid = true;
+                    }
+                    QRect boundingRect( m_captionLayout.boundingRect );
 
                     // text bounding rect
                     boundingRect.setTop( yOffset );
@@ -1005,39 +1200,24 @@ namespace Breeze
 
     void Decoration::createShadow()
     {
-        if ( !g_sShadow ) {
-            g_shadowSizeEnum = m_internalSettings->shadowSize();
-            g_shadowStrength = m_internalSettings->shadowStrength();
-            g_shadowColor = m_internalSettings->shadowColor();
-            g_specificShadowsInactiveWindows = m_internalSettings->specificShadowsInactiveWindows();
-            g_shadowSizeEnumInactiveWindows = m_internalSettings->shadowSizeInactiveWindows();
-            g_shadowStrengthInactiveWindows = m_internalSettings->shadowStrengthInactiveWindows();
-            g_shadowColorInactiveWindows = m_internalSettings->shadowColorInactiveWindows();
-
-            updateShadow();
-        }
-        else if ( g_shadowSizeEnum != m_internalSettings->shadowSize()
-                  || g_shadowStrength != m_internalSettings->shadowStrength()
-                  || g_shadowColor != m_internalSettings->shadowColor() ) {
-            g_shadowSizeEnum = m_internalSettings->shadowSize();
-            g_shadowStrength = m_internalSettings->shadowStrength();
-            g_shadowColor = m_internalSettings->shadowColor();
-
-            updateActiveShadow();
-        }
-        else if ( g_specificShadowsInactiveWindows != m_internalSettings->specificShadowsInactiveWindows()
-                  || g_shadowSizeEnumInactiveWindows != m_internalSettings->shadowSizeInactiveWindows()
-                  || g_shadowStrengthInactiveWindows != m_internalSettings->shadowStrengthInactiveWindows()
-                  || g_shadowColorInactiveWindows != m_internalSettings->shadowColorInactiveWindows() ) {
-            g_specificShadowsInactiveWindows = m_internalSettings->specificShadowsInactiveWindows();
-            g_shadowSizeEnumInactiveWindows = m_internalSettings->shadowSizeInactiveWindows();
-            g_shadowStrengthInactiveWindows = m_internalSettings->shadowStrengthInactiveWindows();
-            g_shadowColorInactiveWindows = m_internalSettings->shadowColorInactiveWindows();
-
-            updateInactiveShadow();
-        }
-        else
-          updateShadow();
+        // shadows that are not cached yet are rendered in the background and
+        // this is called again once they are ready
+        m_activeShadow = cachedShadow(
+            lookupShadowParamsIndex(m_internalSettings->shadowSize()),
+            m_internalSettings->shadowStrength(),
+            m_internalSettings->shadowColor(),
+            m_activeShadow );
+
+        if( m_internalSettings->specificShadowsInactiveWindows() )
+        {
+            m_inactiveShadow = cachedShadow(
+                lookupShadowParamsIndexInactiveWindows(m_internalSettings->shadowSizeInactiveWindows()),
+                m_internalSettings->shadowStrengthInactiveWindows(),
+                m_internalSettings->shadowColorInactiveWindows(),
+                m_inactiveShadow );
+        } else m_inactiveShadow = m_activeShadow;
+
+        updateShadow();
     }
 
     void Decoration::createSizeGrip()
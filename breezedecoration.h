@@ -25,26 +25,65 @@
 #include "breezesettings.h"
 
 #include <KDecoration2/Decoration>
+#include <KDecoration2/DecorationButton>
 #include <KDecoration2/DecoratedClient>
 #include <KDecoration2/DecorationSettings>
 
+#include <QFont>
+#include <QImage>
+#include <QMargins>
 #include <QPalette>
+#include <QStaticText>
 #include <QVariant>
 #include <QVariantAnimation>
 #include <QPainterPath>
 
+#include <array>
+#include <memory>
+
 class QVariantAnimation;
 
 namespace KDecoration2
 {
     class DecorationButton;
     class DecorationButtonGroup;
+    class DecorationShadow;
 }
 
 namespace Breeze
 {
     class SizeGrip;
     class Button;
+    class ShadowCrossFade;
+
+    //* colors of a decoration in its current state, resolved once and shared with its buttons
+    struct ColorPalette
+    {
+        bool active = false;
+
+        QColor rawTitleBar;
+        QColor titleBar;
+        QColor outline;
+        QColor font;
+
+        //* button symbols, and the application menu symbol which follows the title bar
+        QColor symbol;
+        QColor menuSymbol;
+
+        //*@name button orbs and their border, by button type
+        //@{
+        QColor buttonBackground( KDecoration2::DecorationButtonType type ) const
+        { return buttonBackgrounds.at( static_cast<int>( type ) ); }
+
+        QColor buttonBorder( KDecoration2::DecorationButtonType type ) const
+        { return buttonBorders.at( static_cast<int>( type ) ); }
+
+        static constexpr int ButtonTypeCount = static_cast<int>( KDecoration2::DecorationButtonType::Custom ) + 1;
+        std::array<QColor, ButtonTypeCount> buttonBackgrounds;
+        std::array<QColor, ButtonTypeCount> buttonBorders;
+        //@}
+    };
+
     class Decoration : public KDecoration2::Decoration
     {
         Q_OBJECT
@@ -81,10 +120,20 @@ namespace Breeze
 
         //*@name colors
         //@{
-        QColor titleBarColor() const;
-        QColor outlineColor() const;
-        QColor rawTitleBarColor() const;
-        QColor fontColor() const;
+        const ColorPalette &colorPalette() const
+        { return m_palette; }
+
+        QColor titleBarColor() const
+        { return m_palette.titleBar; }
+
+        QColor outlineColor() const
+        { return m_palette.outline; }
+
+        QColor rawTitleBarColor() const
+        { return m_palette.rawTitleBar; }
+
+        QColor fontColor() const
+        { return m_palette.font; }
         //@}
 
         //*@name maximization modes
@@ -134,17 +183,95 @@ namespace Breeze
         void updateSizeGripVisibility();
         void updateBlur();
         void createShadow();
+        void updateShadow();
+        void crossFadeShadow();
+        void updatePalette();
+        void updateClientState();
 
     private:
 
         //* return the rect in which caption will be drawn
         QPair<QRect,Qt::Alignment> captionRect() const;
 
+        //*@name caption layout, reused until caption, font or available width change
+        //@{
+        struct CaptionLayout
+        {
+            QString caption;
+            QFont font;
+
+            //* elided caption, for the available width
+            int width = -1;
+            QStaticText text;
+
+            //* full caption, used to center it on the whole title bar
+            bool boundingRectValid = false;
+            QRect boundingRect;
+        };
+
+        //* drop the layout if caption or font changed
+        void updateCaptionLayout( const QFont& ) const;
+
+        //* elided caption for the painter font and given width
+        const QStaticText &captionText( QPainter *painter, int width );
+        //@}
+
         void createButtons();
         void paintTitleBar(QPainter *painter, const QRect &repaintRegion);
-        void updateShadow();
-        void updateActiveShadow();
-        void updateInactiveShadow();
+
+        //*@name cached background layer
+        //@{
+
+        //* one axis of a nine-slice, where the layer is drawn and from where, in device pixels
+        struct BackgroundSlice
+        {
+            int begin;
+            int end;
+            int source;
+            bool stretch;
+        };
+
+        //* size of the corners of the layer, what is in between only repeats
+        QMargins backgroundSlices() const;
+
+        //* size of one axis of the layer
+        static int backgroundLayerSize( int size, int begin, int end, qreal devicePixelRatio );
+
+        //* split one axis of the decoration, returns the number of slices
+        static int backgroundSlices( int size, int layerSize, int begin, int end, qreal devicePixelRatio, BackgroundSlice *slices );
+
+        //* everything the frame, border and title bar background depend on
+        struct BackgroundKey
+        {
+            QSize size;
+            qreal devicePixelRatio = 0;
+            QColor titleBarColor;
+            QColor outlineColor;
+            int cornerRadius = 0;
+            int smallSpacing = 0;
+            int borderSize = 0;
+            int borderTop = 0;
+            bool hasBorders = false;
+            bool alphaChannelSupported = false;
+            bool shaded = false;
+            bool hideTitleBar = false;
+            Qt::Edges edges;
+
+            bool operator==( const BackgroundKey& other ) const;
+        };
+
+        BackgroundKey backgroundKey( const QSize &layerSize, qreal devicePixelRatio ) const;
+
+        //* frame, border and title bar background for a given size, without buttons, caption and border outline
+        void paintBackground(QPainter *painter, const QSize &size) const;
+        void paintTitleBarBackground(QPainter *painter, const QSize &size) const;
+
+        //@}
+
+        //* shadow for given preset, strength and color, shared between all decorations
+        //* rendered right away without placeholder, otherwise placeholder is returned until createShadow is called again once it is ready
+        QSharedPointer<KDecoration2::DecorationShadow> cachedShadow(int sizeIndex, int shadowStrength, const QColor &shadowColor,
+            const QSharedPointer<KDecoration2::DecorationShadow> &placeholder);
         void calculateWindowAndTitleBarShapes(const bool windowShapeOnly=false);
 
         //*@name border size
@@ -164,18 +291,60 @@ namespace Breeze
         //@}
 
         InternalSettingsPtr m_internalSettings;
+
+        //* client state read while painting and laying out, kept up to date from the client change signals
+        struct ClientState
+        {
+            bool active = false;
+            bool maximized = false;
+            bool maximizedHorizontally = false;
+            bool maximizedVertically = false;
+            bool shaded = false;
+            Qt::Edges adjacentScreenEdges;
+            QString caption;
+        };
+
+        ClientState m_clientState;
+
         KDecoration2::DecorationButtonGroup *m_leftButtons = nullptr;
         KDecoration2::DecorationButtonGroup *m_rightButtons = nullptr;
 
         //* size grip widget
         SizeGrip *m_sizeGrip = nullptr;
 
+        //*@name shadows, both kept alive so focus changes never re-render or re-upload them
+        //@{
+        QSharedPointer<KDecoration2::DecorationShadow> m_activeShadow;
+        QSharedPointer<KDecoration2::DecorationShadow> m_inactiveShadow;
+        //@}
+
+        //*@name shadow transition on focus change
+        //@{
+        QVariantAnimation *m_shadowAnimation;
+        std::unique_ptr<ShadowCrossFade> m_shadowCrossFade;
+        QSharedPointer<KDecoration2::DecorationShadow> m_transitionShadow;
+        int m_shadowTransitionStep = 0;
+        //@}
+
         //* active state change animation
         QVariantAnimation *m_animation;
 
         //* active state change opacity
         qreal m_opacity = 0;
 
+        //* colors for the current state
+        ColorPalette m_palette;
+
+        //* nine-slice background layer and what it was painted for
+        BackgroundKey m_backgroundKey;
+        QImage m_background;
+
+        //* caption layout, also filled by captionRect
+        mutable CaptionLayout m_captionLayout;
+
+        //* where the caption was painted last, repainted along with the new one when it changes
+        QRect m_paintedCaptionRect;
+
         //* Rectangular area of titlebar without clipped corners
         QRect m_titleRect;
         
@@ -204,28 +373,28 @@ namespace Breeze
     }
 
     bool Decoration::isMaximized() const
-    { return client().toStrongRef().data()->isMaximized() && !m_internalSettings->drawBorderOnMaximizedWindows(); }
+    { return m_clientState.maximized && !m_internalSettings->drawBorderOnMaximizedWindows(); }
 
     bool Decoration::isMaximizedHorizontally() const
-    { return client().toStrongRef().data()->isMaximizedHorizontally() && !m_internalSettings->drawBorderOnMaximizedWindows(); }
+    { return m_clientState.maximizedHorizontally && !m_internalSettings->drawBorderOnMaximizedWindows(); }
 
     bool Decoration::isMaximizedVertically() const
-    { return client().toStrongRef().data()->isMaximizedVertically() && !m_internalSettings->drawBorderOnMaximizedWindows(); }
+    { return m_clientState.maximizedVertically && !m_internalSettings->drawBorderOnMaximizedWindows(); }
 
     bool Decoration::isLeftEdge() const
-    { return (client().toStrongRef().data()->isMaximizedHorizontally() || client().toStrongRef().data()->adjacentScreenEdges().testFlag( Qt::LeftEdge ) ) && !m_internalSettings->drawBorderOnMaximizedWindows(); }
+    { return (m_clientState.maximizedHorizontally || m_clientState.adjacentScreenEdges.testFlag( Qt::LeftEdge ) ) && !m_internalSettings->drawBorderOnMaximizedWindows(); }
 
     bool Decoration::isRightEdge() const
-    { return (client().toStrongRef().data()->isMaximizedHorizontally() || client().toStrongRef().data()->adjacentScreenEdges().testFlag( Qt::RightEdge ) ) && !m_internalSettings->drawBorderOnMaximizedWindows(); }
+    { return (m_clientState.maximizedHorizontally || m_clientState.adjacentScreenEdges.testFlag( Qt::RightEdge ) ) && !m_internalSettings->drawBorderOnMaximizedWindows(); }
 
     bool Decoration::isTopEdge() const
-    { return (client().toStrongRef().data()->isMaximizedVertically() || client().toStrongRef().data()->adjacentScreenEdges().testFlag( Qt::TopEdge ) ) && !m_internalSettings->drawBorderOnMaximizedWindows(); }
+    { return (m_clientState.maximizedVertically || m_clientState.adjacentScreenEdges.testFlag( Qt::TopEdge ) ) && !m_internalSettings->drawBorderOnMaximizedWindows(); }
 
     bool Decoration::isBottomEdge() const
-    { return (client().toStrongRef().data()->isMaximizedVertically() || client().toStrongRef().data()->adjacentScreenEdges().testFlag( Qt::BottomEdge ) ) && !m_internalSettings->drawBorderOnMaximizedWindows(); }
+    { return (m_clientState.maximizedVertically || m_clientState.adjacentScreenEdges.testFlag( Qt::BottomEdge ) ) && !m_internalSettings->drawBorderOnMaximizedWindows(); }
 
     bool Decoration::hideTitleBar() const
-    { return m_internalSettings->hideTitleBar() == 3 || ( m_internalSettings->hideTitleBar() == 1 && client().toStrongRef().data()->isMaximized() ) || ( m_internalSettings->hideTitleBar() == 2 && ( client().toStrongRef().data()->isMaximized() || client().toStrongRef().data()->isMaximizedVertically()  || client().toStrongRef().data()->isMaximizedHorizontally()) ); }
+    { return m_internalSettings->hideTitleBar() == 3 || ( m_internalSettings->hideTitleBar() == 1 && m_clientState.maximized ) || ( m_internalSettings->hideTitleBar() == 2 && ( m_clientState.maximized || m_clientState.maximizedVertically  || m_clientState.maximizedHorizontally) ); }
 
     bool Decoration::matchColorForTitleBar() const
     { return m_internalSettings->matchColorForTitleBar(); }
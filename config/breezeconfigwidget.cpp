@@ -66,6 +66,8 @@ namespace Breeze
         connect( m_ui.shadowSizeInactiveWindows, SIGNAL(currentIndexChanged(int)), SLOT(updateChanged()) );
         connect( m_ui.shadowStrengthInactiveWindows, SIGNAL(valueChanged(int)), SLOT(updateChanged()) );
         connect( m_ui.shadowColorInactiveWindows, &KColorButton::changed, this, &ConfigWidget::updateChanged );
+        connect( m_ui.shadowTransition, &QAbstractButton::clicked, this, &ConfigWidget::updateChanged );
+        connect( m_ui.shadowTransitionDuration, SIGNAL(valueChanged(int)), SLOT(updateChanged()) );
 
         // track exception changes
         connect( m_ui.exceptions, &ExceptionListWidget::changed, this, &ConfigWidget::updateChanged );
@@ -105,6 +107,9 @@ namespace Breeze
         m_ui.shadowStrengthInactiveWindows->setValue( qRound(qreal(m_internalSettings->shadowStrengthInactiveWindows()*100)/255 ) );
         m_ui.shadowColorInactiveWindows->setColor( m_internalSettings->shadowColorInactiveWindows() );
 
+        m_ui.shadowTransition->setChecked( m_internalSettings->shadowTransition() );
+        m_ui.shadowTransitionDuration->setValue( m_internalSettings->shadowTransitionDuration() );
+
         // load exceptions
         ExceptionList exceptions;
         exceptions.readConfig( m_configuration );
@@ -143,6 +148,9 @@ namespace Breeze
         m_internalSettings->setShadowStrengthInactiveWindows( qRound( qreal(m_ui.shadowStrengthInactiveWindows->value()*255)/100 ) );
         m_internalSettings->setShadowColorInactiveWindows( m_ui.shadowColorInactiveWindows->color() );
 
+        m_internalSettings->setShadowTransition( m_ui.shadowTransition->isChecked() );
+        m_internalSettings->setShadowTransitionDuration( m_ui.shadowTransitionDuration->value() );
+
         // save configuration
         m_internalSettings->save();
 
@@ -198,6 +206,9 @@ namespace Breeze
         m_ui.shadowStrengthInactiveWindows->setValue( qRound(qreal(m_internalSettings->shadowStrengthInactiveWindows()*100)/255 ) );
         m_ui.shadowColorInactiveWindows->setColor( m_internalSettings->shadowColorInactiveWindows() );
 
+        m_ui.shadowTransition->setChecked( m_internalSettings->shadowTransition() );
+        m_ui.shadowTransitionDuration->setValue( m_internalSettings->shadowTransitionDuration() );
+
     }
 
     void ConfigWidget::updateChanged()
@@ -232,6 +243,9 @@ namespace Breeze
         else if( qRound( qreal(m_ui.shadowStrengthInactiveWindows->value()*255)/100 ) != m_internalSettings->shadowStrengthInactiveWindows() ) modified = true;
         else if( m_ui.shadowColorInactiveWindows->color() != m_internalSettings->shadowColorInactiveWindows() ) modified = true;
 
+        else if( m_ui.shadowTransition->isChecked() != m_internalSettings->shadowTransition() ) modified = true;
+        else if( m_ui.shadowTransitionDuration->value() != m_internalSettings->shadowTransitionDuration() ) modified = true;
+
         // exceptions
         else if( m_ui.exceptions->isChanged() ) modified = true;
 
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// own
+#include "breezeboxblurkernel.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Breeze
+{
+
+#if defined(__SSE2__)
+
+namespace
+{
+
+struct Sse2Ops
+{
+    using Vector = __m128i;
+
+    static inline Vector set1(int value)
+    {
+        return _mm_set1_epi32(value);
+    }
+
+    static inline Vector add(Vector a, Vector b)
+    {
+        return _mm_add_epi32(a, b);
+    }
+
+    static inline Vector sub(Vector a, Vector b)
+    {
+        return _mm_sub_epi32(a, b);
+    }
+
+    static inline Vector mullo(Vector a, Vector b)
+    {
+        // SSE2 has no 32-bit low multiply, emulate it with two 32x32->64 multiplies.
+        const __m128i even = _mm_mul_epu32(a, b);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    static inline Vector srl24(Vector a)
+    {
+        return _mm_srli_epi32(a, 24);
+    }
+
+    static inline Vector load(const uint8_t *src, int laneStep)
+    {
+        if (laneStep == 1) {
+            int32_t packed;
+            std::memcpy(&packed, src, sizeof(packed));
+            const __m128i zero = _mm_setzero_si128();
+            return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        }
+
+        return _mm_setr_epi32(src[0], src[laneStep], src[2 * laneStep], src[3 * laneStep]);
+    }
+
+    static inline void store(uint8_t *dst, int laneStep, Vector value)
+    {
+        if (laneStep == 1) {
+            const __m128i words = _mm_packs_epi32(value, value);
+            const int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+            std::memcpy(dst, &packed, sizeof(packed));
+            return;
+        }
+
+        dst[0] = static_cast<uint8_t>(_mm_cvtsi128_si32(value));
+        dst[laneStep] = static_cast<uint8_t>(_mm_cvtsi128_si32(_mm_srli_si128(value, 4)));
+        dst[2 * laneStep] = static_cast<uint8_t>(_mm_cvtsi128_si32(_mm_srli_si128(value, 8)));
+        dst[3 * laneStep] = static_cast<uint8_t>(_mm_cvtsi128_si32(_mm_srli_si128(value, 12)));
+    }
+};
+
+} // anonymous namespace
+
+void boxBlurLanesSse2(const uint8_t *src, int srcStep, int srcLaneStep,
+                      uint8_t *dst, int dstStep, int dstLaneStep,
+                      int length, const BoxLobes &lobes)
+{
+    boxBlurLanes<Sse2Ops>(src, srcStep, srcLaneStep, dst, dstStep, dstLaneStep, length, lobes);
+}
+
+#endif
+
+static BoxBlurKernel selectBoxBlurKernel()
+{
+#if BREEZE_COMMON_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"AVX2", 8, boxBlurLanesAvx2};
+    }
+#endif
+
+#if defined(__SSE2__)
+    return {"SSE2", 4, boxBlurLanesSse2};
+#else
+    return {"scalar", 0, nullptr};
+#endif
+}
+
+const BoxBlurKernel &boxBlurKernel()
+{
+    static const BoxBlurKernel kernel = selectBoxBlurKernel();
+    return kernel;
+}
+
+} // namespace Breeze
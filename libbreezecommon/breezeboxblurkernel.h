@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+// This header is private to libbreezecommon, the vector kernels are only
+// exported for the autotests.
+
+#include "breezecommon_export.h"
+#include "config-breezecommon.h"
+
+#include <cstdint>
+
+namespace Breeze
+{
+
+struct BoxLobes
+{
+    int left;  ///< how many pixels sample to the left
+    int right; ///< how many pixels sample to the right
+};
+
+/**
+ * Process several rows (lanes) with a box filter at once.
+ *
+ * Lane @c i of position @c p is read from <tt>src[p * srcStep + i * srcLaneStep]</tt>
+ * and written to <tt>dst[p * dstStep + i * dstLaneStep]</tt>. Edges are clamped the
+ * same way as in the scalar implementation, so results are byte-identical to it.
+ *
+ * @param src The first alpha value of the first lane.
+ * @param srcStep The number of bytes from one position to the next one.
+ * @param srcLaneStep The number of bytes from one lane to the next one.
+ * @param dst The destination.
+ * @param dstStep The number of bytes from one position to the next one.
+ * @param dstLaneStep The number of bytes from one lane to the next one.
+ * @param length The number of positions in each lane.
+ * @param lobes Params of the box filter.
+ **/
+using BoxBlurLanesFunction = void (*)(const uint8_t *src, int srcStep, int srcLaneStep,
+                                      uint8_t *dst, int dstStep, int dstLaneStep,
+                                      int length, const BoxLobes &lobes);
+
+struct BoxBlurKernel
+{
+    const char *name;                 ///< human readable name of the instruction set
+    int lanes;                        ///< number of lanes processed by one call, 0 if unavailable
+    BoxBlurLanesFunction blurLanes;   ///< the kernel, nullptr if unavailable
+};
+
+/**
+ * Returns the fastest box blur kernel supported by the CPU.
+ *
+ * The kernel is picked once, at the first call. If no vector kernel is
+ * available, the returned kernel has zero lanes and callers should use
+ * the scalar path.
+ **/
+const BoxBlurKernel &boxBlurKernel();
+
+#if defined(__SSE2__)
+BREEZECOMMON_EXPORT void boxBlurLanesSse2(const uint8_t *src, int srcStep, int srcLaneStep,
+                                          uint8_t *dst, int dstStep, int dstLaneStep,
+                                          int length, const BoxLobes &lobes);
+#endif
+
+#if BREEZE_COMMON_HAVE_AVX2
+BREEZECOMMON_EXPORT void boxBlurLanesAvx2(const uint8_t *src, int srcStep, int srcLaneStep,
+                                          uint8_t *dst, int dstStep, int dstLaneStep,
+                                          int length, const BoxLobes &lobes);
+#endif
+
+/**
+ * Generic sliding window implementation shared by the vector kernels.
+ *
+ * @p Ops provides the vector type and the handful of operations that the
+ * kernel needs. It is instantiated once per instruction set, in a translation
+ * unit that is compiled with matching compiler flags, hence the internal linkage.
+ **/
+template<typename Ops>
+static inline void boxBlurLanes(const uint8_t *src, int srcStep, int srcLaneStep,
+                                uint8_t *dst, int dstStep, int dstLaneStep,
+                                int length, const BoxLobes &lobes)
+{
+    using Vector = typename Ops::Vector;
+
+    const int boxSize = lobes.left + 1 + lobes.right;
+    const Vector reciprocal = Ops::set1((1 << 24) / boxSize);
+
+    const Vector firstValue = Ops::load(src, srcLaneStep);
+    const Vector lastValue = Ops::load(src + (length - 1) * srcStep, srcLaneStep);
+
+    Vector alphaSum = Ops::add(Ops::set1((boxSize + 1) / 2),
+                               Ops::mullo(firstValue, Ops::set1(lobes.left)));
+
+    int right = 0;
+    int left = 0;
+    int out = 0;
+
+    for (; right < boxSize - lobes.left; ++right) {
+        alphaSum = Ops::add(alphaSum, Ops::load(src + right * srcStep, srcLaneStep));
+    }
+
+    for (; right < boxSize; ++right, ++out) {
+        Ops::store(dst + out * dstStep, dstLaneStep, Ops::srl24(Ops::mullo(alphaSum, reciprocal)));
+        alphaSum = Ops::add(alphaSum, Ops::sub(Ops::load(src + right * srcStep, srcLaneStep), firstValue));
+    }
+
+    for (; right < length; ++right, ++left, ++out) {
+        Ops::store(dst + out * dstStep, dstLaneStep, Ops::srl24(Ops::mullo(alphaSum, reciprocal)));
+        alphaSum = Ops::add(alphaSum, Ops::sub(Ops::load(src + right * srcStep, srcLaneStep),
+                                               Ops::load(src + left * srcStep, srcLaneStep)));
+    }
+
+    for (; out < length; ++left, ++out) {
+        Ops::store(dst + out * dstStep, dstLaneStep, Ops::srl24(Ops::mullo(alphaSum, reciprocal)));
+        alphaSum = Ops::add(alphaSum, Ops::sub(lastValue, Ops::load(src + left * srcStep, srcLaneStep)));
+    }
+}
+
+} // namespace Breeze
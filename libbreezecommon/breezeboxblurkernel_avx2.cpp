@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// This file is compiled with -mavx2, nothing in here may be called
+// without checking that the CPU supports AVX2 first.
+
+// own
+#include "breezeboxblurkernel.h"
+
+#include <immintrin.h>
+
+namespace Breeze
+{
+
+namespace
+{
+
+struct Avx2Ops
+{
+    using Vector = __m256i;
+
+    static inline Vector set1(int value)
+    {
+        return _mm256_set1_epi32(value);
+    }
+
+    static inline Vector add(Vector a, Vector b)
+    {
+        return _mm256_add_epi32(a, b);
+    }
+
+    static inline Vector sub(Vector a, Vector b)
+    {
+        return _mm256_sub_epi32(a, b);
+    }
+
+    static inline Vector mullo(Vector a, Vector b)
+    {
+        return _mm256_mullo_epi32(a, b);
+    }
+
+    static inline Vector srl24(Vector a)
+    {
+        return _mm256_srli_epi32(a, 24);
+    }
+
+    static inline Vector load(const uint8_t *src, int laneStep)
+    {
+        if (laneStep == 1) {
+            return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+        }
+
+        return _mm256_setr_epi32(src[0], src[laneStep], src[2 * laneStep], src[3 * laneStep],
+                                 src[4 * laneStep], src[5 * laneStep], src[6 * laneStep], src[7 * laneStep]);
+    }
+
+    static inline void store(uint8_t *dst, int laneStep, Vector value)
+    {
+        const __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+        const __m128i bytes = _mm_packus_epi16(words, words);
+
+        if (laneStep == 1) {
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), bytes);
+            return;
+        }
+
+        alignas(16) uint8_t lanes[16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), bytes);
+        for (int i = 0; i < 8; ++i) {
+            dst[i * laneStep] = lanes[i];
+        }
+    }
+};
+
+} // anonymous namespace
+
+void boxBlurLanesAvx2(const uint8_t *src, int srcStep, int srcLaneStep,
+                      uint8_t *dst, int dstStep, int dstLaneStep,
+                      int length, const BoxLobes &lobes)
+{
+    boxBlurLanes<Avx2Ops>(src, srcStep, srcLaneStep, dst, dstStep, dstLaneStep, length, lobes);
+}
+
+} // namespace Breeze
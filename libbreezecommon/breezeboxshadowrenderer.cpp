@@ -20,11 +20,27 @@
 
 // own
 #include "breezeboxshadowrenderer.h"
+#include "breezeboxblurkernel.h"
+#include "breezeshadowmask.h"
+#include "breezeshadowdiskcache.h"
 
 // Qt
+#include <QCache>
+#include <QMutex>
 #include <QPainter>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QVarLengthArray>
 #include <QtMath>
 
+// std
+#include <array>
+#include <cstring>
+#include <functional>
+#include <vector>
+
 namespace Breeze
 {
 
@@ -47,21 +63,28 @@ static inline QSize calculateBlurExtent(int radius)
     return QSize(blurRadius, blurRadius);
 }
 
-struct BoxLobes
+/**
+ * Returns the offset of the alpha value within a pixel of the given image.
+ *
+ * @param image An 8-bit alpha mask or a 32-bit ARGB image.
+ **/
+static inline int alphaChannelOffset(const QImage &image)
 {
-    int left;  ///< how many pixels sample to the left
-    int right; ///< how many pixels sample to the right
-};
+    if (image.format() == QImage::Format_Alpha8) {
+        return 0;
+    }
+
+    return QSysInfo::ByteOrder == QSysInfo::BigEndian ? 0 : 3;
+}
 
 /**
- * Compute box filter parameters.
+ * Split the extent of a blur into three box filters.
  *
- * @param radius The blur radius.
+ * @param blurRadius How far the three box filters reach together, at least 1.
  * @returns Parameters for three box filters.
  **/
-static QVector<BoxLobes> computeLobes(int radius)
+static std::array<BoxLobes, 3> splitBlurRadius(int blurRadius)
 {
-    const int blurRadius = calculateBlurRadius(calculateBlurStdDev(radius));
     const int z = blurRadius / 3;
 
     int major;
@@ -93,32 +116,39 @@ static QVector<BoxLobes> computeLobes(int radius)
 
     Q_ASSERT(major + minor + final == blurRadius);
 
-    return {
+    return {{
         {major, minor},
         {minor, major},
         {final, final}
-    };
+    }};
 }
 
 /**
- * Process a row with a box filter.
+ * Compute box filter parameters.
  *
- * @param src The start of the row.
- * @param dst The destination.
- * @param width The width of the row, in pixels.
- * @param horizontalStride The number of bytes from one alpha value to the
- *    next alpha value.
- * @param verticalStride The number of bytes from one row to the next row.
- * @param lobes Params of the box filter.
- * @param transposeInput Whether the input is transposed.
- * @param transposeOutput Whether the output should be transposed.
+ * @param radius The blur radius.
+ * @returns Parameters for three box filters.
  **/
-static inline void boxBlurRowAlpha(const uint8_t *src, uint8_t *dst, int width, int horizontalStride,
-                                   int verticalStride, const BoxLobes &lobes, bool transposeInput,
-                                   bool transposeOutput)
+static inline std::array<BoxLobes, 3> computeLobes(int radius)
 {
-    const int inputStep = transposeInput ? verticalStride : horizontalStride;
-    const int outputStep = transposeOutput ? verticalStride : horizontalStride;
+    return splitBlurRadius(calculateBlurRadius(calculateBlurStdDev(radius)));
+}
+
+/**
+ * Process a row with a box filter, with the steps between alpha values fixed.
+ *
+ * @tparam InputStep The number of bytes from one input alpha value to the next,
+ *    or 0 to take it from @p runtimeInputStep.
+ * @tparam OutputStep The number of bytes from one output alpha value to the next,
+ *    or 0 to take it from @p runtimeOutputStep.
+ **/
+template<int InputStep, int OutputStep>
+static inline void boxBlurRowAlphaStepped(const uint8_t *src, uint8_t *dst, int width, int runtimeInputStep,
+                                          int runtimeOutputStep, const BoxLobes &lobes)
+{
+    // Steps known at compile time take precedence over the runtime ones.
+    const int inputStep = InputStep ? InputStep : runtimeInputStep;
+    const int outputStep = OutputStep ? OutputStep : runtimeOutputStep;
 
     const int boxSize = lobes.left + 1 + lobes.right;
     const int reciprocal = (1 << 24) / boxSize;
@@ -167,49 +197,323 @@ static inline void boxBlurRowAlpha(const uint8_t *src, uint8_t *dst, int width,
 }
 
 /**
- * Blur the alpha channel of a given image.
+ * Process a row with a box filter.
  *
- * @param image The input image.
- * @param radius The blur radius.
- * @param rect Specifies what part of the image to blur. If nothing is provided, then
- *    the whole alpha channel of the input image will be blurred.
+ * @param src The start of the row.
+ * @param dst The destination.
+ * @param width The width of the row, in pixels.
+ * @param horizontalStride The number of bytes from one alpha value to the
+ *    next alpha value.
+ * @param verticalStride The number of bytes from one row to the next row.
+ * @param lobes Params of the box filter.
+ * @param transposeInput Whether the input is transposed.
+ * @param transposeOutput Whether the output should be transposed.
  **/
-static inline void boxBlurAlpha(QImage &image, int radius, const QRect &rect = {})
+static inline void boxBlurRowAlpha(const uint8_t *src, uint8_t *dst, int width, int horizontalStride,
+                                   int verticalStride, const BoxLobes &lobes, bool transposeInput,
+                                   bool transposeOutput)
 {
-    if (radius < 2) {
+    const int inputStep = transposeInput ? verticalStride : horizontalStride;
+    const int outputStep = transposeOutput ? verticalStride : horizontalStride;
+
+    // Rows of alpha masks and of ARGB images, and columns going to or coming
+    // from the packed scratch buffers, have dedicated instances.
+    if (inputStep == 1 && outputStep == 1) {
+        boxBlurRowAlphaStepped<1, 1>(src, dst, width, inputStep, outputStep, lobes);
+    } else if (inputStep == 4 && outputStep == 4) {
+        boxBlurRowAlphaStepped<4, 4>(src, dst, width, inputStep, outputStep, lobes);
+    } else if (outputStep == 1) {
+        boxBlurRowAlphaStepped<0, 1>(src, dst, width, inputStep, outputStep, lobes);
+    } else if (inputStep == 1) {
+        boxBlurRowAlphaStepped<1, 0>(src, dst, width, inputStep, outputStep, lobes);
+    } else {
+        boxBlurRowAlphaStepped<0, 0>(src, dst, width, inputStep, outputStep, lobes);
+    }
+}
+
+// Number of rows, or columns, that are worth handing over to another thread.
+// Multiple of the lane count of all vector kernels.
+static const int s_linesPerTask = 32;
+
+// Threads other than the calling one that work on a single shadow.
+static const int s_maxShadowThreads = 3;
+
+Q_GLOBAL_STATIC(QThreadPool, s_shadowThreadPool)
+
+static QThreadPool *shadowThreadPool()
+{
+    static QThreadPool *pool = [] {
+        QThreadPool *pool = s_shadowThreadPool();
+        pool->setMaxThreadCount(qBound(1, QThread::idealThreadCount() - 1, s_maxShadowThreads));
+        return pool;
+    }();
+    return pool;
+}
+
+// Set on the threads of the pool, work started from them is not split further
+// so that no thread of the pool ever waits for another one.
+static thread_local bool s_isShadowThread = false;
+
+namespace
+{
+
+class ShadowTask : public QRunnable
+{
+public:
+    explicit ShadowTask(const std::function<void()> &function)
+        : m_function(function)
+    {
+    }
+
+    void run() override
+    {
+        s_isShadowThread = true;
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+
+} // anonymous namespace
+
+/**
+ * Split a range of independent items into chunks and process them in parallel.
+ *
+ * The calling thread processes the first chunk itself and returns once all
+ * chunks are done, so the result is the same as with a single call covering
+ * the whole range.
+ *
+ * @param count The number of items.
+ * @param grain The minimum number of items per chunk, chunks are a multiple of it.
+ * @param function Processes the items in [begin, end), called from several threads at once.
+ **/
+template<typename Function>
+static void parallelFor(int count, int grain, const Function &function)
+{
+    QThreadPool *pool = shadowThreadPool();
+
+    const int grainCount = (count + grain - 1) / grain;
+    const int maxChunkCount = s_isShadowThread ? 1 : qMin(QThread::idealThreadCount(), pool->maxThreadCount() + 1);
+    const int chunkSize = grain * ((grainCount + maxChunkCount - 1) / maxChunkCount);
+    const int chunkCount = chunkSize > 0 ? (count + chunkSize - 1) / chunkSize : 0;
+
+    if (chunkCount <= 1) {
+        function(0, count);
         return;
     }
 
-    const QVector<BoxLobes> lobes = computeLobes(radius);
+    QSemaphore done;
+    for (int chunk = 1; chunk < chunkCount; ++chunk) {
+        const int begin = chunk * chunkSize;
+        const int end = qMin(count, begin + chunkSize);
+        pool->start(new ShadowTask([&function, &done, begin, end] {
+            function(begin, end);
+            done.release();
+        }));
+    }
+
+    function(0, chunkSize);
+    done.acquire(chunkCount - 1);
+}
+
+namespace
+{
+
+/**
+ * Scratch memory of the shadow pipeline.
+ *
+ * Every thread has a workspace of its own that is kept across renders. Its
+ * buffers only ever grow, so once the largest shadow has been rendered, the
+ * pipeline doesn't allocate scratch memory anymore.
+ **/
+class ShadowWorkspace
+{
+public:
+    //* buffers that are used at the same time need to be distinct
+    enum Buffer {
+        BlurBuffer,
+        BlockBuffer,
+        TransposedBlockBuffer,
+        EdgeBuffer,
+        ProfileBuffer,
+        BufferCount
+    };
+
+    //* workspace of the calling thread
+    static ShadowWorkspace &local()
+    {
+        static thread_local ShadowWorkspace workspace;
+        return workspace;
+    }
+
+    //* returns room for at least @p count values, valid until the buffer is requested again
+    template<typename T>
+    T *buffer(Buffer buffer, int count)
+    {
+        std::vector<char> &data = m_buffers[buffer];
+        const size_t size = count * sizeof(T);
+        if (data.size() < size) {
+            data.resize(size);
+        }
+        return reinterpret_cast<T *>(data.data());
+    }
+
+private:
+    std::vector<char> m_buffers[BufferCount];
+};
+
+} // anonymous namespace
 
+// Width of the strips of packed columns of the tiled vertical pass, one cache line.
+static const int s_verticalTileWidth = 64;
+
+/**
+ * Copy the alpha values of a block of pixels.
+ *
+ * @param src The first alpha value of the source block.
+ * @param srcRowStride The number of bytes from one row of the source to the next.
+ * @param srcPixelStride The number of bytes from one alpha value of the source to the next.
+ * @param dst The first alpha value of the destination block.
+ * @param dstRowStride The number of bytes from one row of the destination to the next.
+ * @param dstPixelStride The number of bytes from one alpha value of the destination to the next.
+ * @param width The width of the block, in pixels.
+ * @param height The height of the block, in pixels.
+ **/
+static inline void copyAlphaBlock(const uint8_t *src, int srcRowStride, int srcPixelStride,
+                                  uint8_t *dst, int dstRowStride, int dstPixelStride, int width, int height)
+{
+    for (int y = 0; y < height; ++y, src += srcRowStride, dst += dstRowStride) {
+        for (int x = 0; x < width; ++x) {
+            dst[x * dstPixelStride] = src[x * srcPixelStride];
+        }
+    }
+}
+
+/**
+ * Blur the alpha channel of a given image.
+ *
+ * @param image The input image.
+ * @param lobes Parameters for three box filters.
+ * @param rect Specifies what part of the image to blur. If nothing is provided, then
+ *    the whole alpha channel of the input image will be blurred.
+ * @param tiledColumns Whether to pack strips of columns into a tile for the vertical pass,
+ *    see ShadowMask::VerticalPass.
+ **/
+static inline void boxBlurAlpha(QImage &image, const std::array<BoxLobes, 3> &lobes, const QRect &rect = {},
+                                bool tiledColumns = false)
+{
     const QRect blurRect = rect.isNull() ? image.rect() : rect;
 
-    const int alphaOffset = QSysInfo::ByteOrder == QSysInfo::BigEndian ? 0 : 3;
+    const int alphaOffset = alphaChannelOffset(image);
     const int width = blurRect.width();
     const int height = blurRect.height();
     const int rowStride = image.bytesPerLine();
     const int pixelStride = image.depth() >> 3;
 
-    const int bufferStride = qMax(width, height) * pixelStride;
-    QScopedPointer<uint8_t, QScopedPointerArrayDeleter<uint8_t> > buf(new uint8_t[2 * bufferStride]);
-    uint8_t *buf1 = buf.data();
-    uint8_t *buf2 = buf1 + bufferStride;
+    // Vector kernels keep one alpha value per lane in their scratch buffers.
+    const BoxBlurKernel &kernel = boxBlurKernel();
+    const int lanes = kernel.lanes;
 
-    // Blur the image in horizontal direction.
-    for (int i = 0; i < height; ++i) {
-        uint8_t *row = image.scanLine(blurRect.y() + i) + blurRect.x() * pixelStride + alphaOffset;
-        boxBlurRowAlpha(row, buf1, width, pixelStride, rowStride, lobes[0], false, false);
-        boxBlurRowAlpha(buf1, buf2, width, pixelStride, rowStride, lobes[1], false, false);
-        boxBlurRowAlpha(buf2, row, width, pixelStride, rowStride, lobes[2], false, false);
-    }
+    const int bufferStride = qMax(width, height) * qMax(pixelStride, lanes);
+
+    uint8_t *origin = image.scanLine(blurRect.y()) + blurRect.x() * pixelStride + alphaOffset;
 
-    // Blur the image in vertical direction.
-    for (int i = 0; i < width; ++i) {
-        uint8_t *column = image.scanLine(blurRect.y()) + (blurRect.x() + i) * pixelStride + alphaOffset;
-        boxBlurRowAlpha(column, buf1, height, pixelStride, rowStride, lobes[0], true, false);
-        boxBlurRowAlpha(buf1, buf2, height, pixelStride, rowStride, lobes[1], false, false);
-        boxBlurRowAlpha(buf2, column, height, pixelStride, rowStride, lobes[2], false, true);
+    // Rows, and later columns, don't depend on each other. They are blurred in
+    // strips in parallel, every thread with its own scratch buffers.
+
+    // Blur the image in horizontal direction, several rows at once if possible.
+    parallelFor(height, s_linesPerTask, [&](int begin, int end) {
+        uint8_t *buf1 = ShadowWorkspace::local().buffer<uint8_t>(ShadowWorkspace::BlurBuffer, 2 * bufferStride);
+        uint8_t *buf2 = buf1 + bufferStride;
+
+        int i = begin;
+        if (lanes) {
+            for (; i + lanes <= end; i += lanes) {
+                uint8_t *rows = origin + i * rowStride;
+                kernel.blurLanes(rows, pixelStride, rowStride, buf1, lanes, 1, width, lobes[0]);
+                kernel.blurLanes(buf1, lanes, 1, buf2, lanes, 1, width, lobes[1]);
+                kernel.blurLanes(buf2, lanes, 1, rows, pixelStride, rowStride, width, lobes[2]);
+            }
+        }
+
+        for (; i < end; ++i) {
+            uint8_t *row = origin + i * rowStride;
+            boxBlurRowAlpha(row, buf1, width, pixelStride, rowStride, lobes[0], false, false);
+            boxBlurRowAlpha(buf1, buf2, width, pixelStride, rowStride, lobes[1], false, false);
+            boxBlurRowAlpha(buf2, row, width, pixelStride, rowStride, lobes[2], false, false);
+        }
+    });
+
+    // Blur the image in vertical direction, several columns at once if possible.
+    // The vector kernels load adjacent columns of a mask as one contiguous run per
+    // row already, so columns are blurred in place. Packing strips of them into a
+    // tile first is only kept to measure it, the copies cost more than they save.
+    const int columnsPerTask = tiledColumns ? s_verticalTileWidth : s_linesPerTask;
+
+    parallelFor(width, columnsPerTask, [&](int begin, int end) {
+        const int tileSize = tiledColumns ? height * s_verticalTileWidth : 0;
+        uint8_t *buf1 = ShadowWorkspace::local().buffer<uint8_t>(ShadowWorkspace::BlurBuffer, 2 * bufferStride + tileSize);
+        uint8_t *buf2 = buf1 + bufferStride;
+        uint8_t *tile = buf2 + bufferStride;
+
+        const int stripWidth = tiledColumns ? s_verticalTileWidth : end - begin;
+
+        for (int x = begin; x < end; x += stripWidth) {
+            const int columnCount = qMin(stripWidth, end - x);
+            uint8_t *strip = origin + x * pixelStride;
+
+            uint8_t *columns = strip;
+            int columnRowStride = rowStride;
+            int columnPixelStride = pixelStride;
+            if (tiledColumns) {
+                copyAlphaBlock(strip, rowStride, pixelStride, tile, s_verticalTileWidth, 1, columnCount, height);
+                columns = tile;
+                columnRowStride = s_verticalTileWidth;
+                columnPixelStride = 1;
+            }
+
+            int i = 0;
+            if (lanes) {
+                for (; i + lanes <= columnCount; i += lanes) {
+                    uint8_t *column = columns + i * columnPixelStride;
+                    kernel.blurLanes(column, columnRowStride, columnPixelStride, buf1, lanes, 1, height, lobes[0]);
+                    kernel.blurLanes(buf1, lanes, 1, buf2, lanes, 1, height, lobes[1]);
+                    kernel.blurLanes(buf2, lanes, 1, column, columnRowStride, columnPixelStride, height, lobes[2]);
+                }
+            }
+
+            for (; i < columnCount; ++i) {
+                uint8_t *column = columns + i * columnPixelStride;
+                boxBlurRowAlpha(column, buf1, height, columnPixelStride, columnRowStride, lobes[0], true, false);
+                boxBlurRowAlpha(buf1, buf2, height, columnPixelStride, columnRowStride, lobes[1], false, false);
+                boxBlurRowAlpha(buf2, column, height, columnPixelStride, columnRowStride, lobes[2], false, true);
+            }
+
+            if (tiledColumns) {
+                copyAlphaBlock(tile, s_verticalTileWidth, 1, strip, rowStride, pixelStride, columnCount, height);
+            }
+        }
+    });
+}
+
+/**
+ * Blur the alpha channel of a given image.
+ *
+ * @param image The input image.
+ * @param radius The blur radius.
+ * @param rect Specifies what part of the image to blur. If nothing is provided, then
+ *    the whole alpha channel of the input image will be blurred.
+ * @param tiledColumns Whether to pack strips of columns into a tile for the vertical pass,
+ *    see ShadowMask::VerticalPass.
+ **/
+static inline void boxBlurAlpha(QImage &image, int radius, const QRect &rect = {}, bool tiledColumns = false)
+{
+    if (radius < 2) {
+        return;
     }
+
+    boxBlurAlpha(image, computeLobes(radius), rect, tiledColumns);
 }
 
 static inline void mirrorTopLeftQuadrant(QImage &image)
@@ -220,7 +524,7 @@ static inline void mirrorTopLeftQuadrant(QImage &image)
     const int centerX = qCeil(width * 0.5);
     const int centerY = qCeil(height * 0.5);
 
-    const int alphaOffset = QSysInfo::ByteOrder == QSysInfo::BigEndian ? 0 : 3;
+    const int alphaOffset = alphaChannelOffset(image);
     const int stride = image.depth() >> 3;
 
     for (int y = 0; y < centerY; ++y) {
@@ -234,7 +538,7 @@ static inline void mirrorTopLeftQuadrant(QImage &image)
 
     for (int y = 0; y < centerY; ++y) {
         const uint8_t *in = image.scanLine(y) + alphaOffset;
-        uint8_t *out = image.scanLine(width - y - 1) + alphaOffset;
+        uint8_t *out = image.scanLine(height - y - 1) + alphaOffset;
 
         for (int x = 0; x < width; ++x, in += stride, out += stride) {
             *out = *in;
@@ -242,49 +546,682 @@ static inline void mirrorTopLeftQuadrant(QImage &image)
     }
 }
 
-static void renderShadow(QPainter *painter, const QRect &rect, qreal borderRadius, const QPoint &offset, int radius, const QColor &color)
+/**
+ * Extend the blurred corner of the top-left quadrant to the whole quadrant.
+ *
+ * Past the corner the shadow only varies across the straight edges, so the last
+ * column of the corner is the profile of the top edge and its last row is the
+ * profile of the left edge. Both are simply repeated.
+ *
+ * @param image The input image.
+ * @param corner Size of the corner that has been blurred already.
+ * @param quadrant Size of the top-left quadrant.
+ **/
+static inline void boxBlurRow(const uint8_t *src, int srcStep, uint8_t *dst, int dstStep, int length, const BoxLobes &lobes)
+{
+    // the input step is the horizontal one, the output step the vertical one
+    boxBlurRowAlpha(src, dst, length, srcStep, dstStep, lobes, false, true);
+}
+
+void extendCorner(QImage &image, const QSize &corner, const QSize &quadrant)
+{
+    const int alphaOffset = alphaChannelOffset(image);
+    const int stride = image.depth() >> 3;
+
+    for (int y = 0; y < corner.height(); ++y) {
+        uint8_t *row = image.scanLine(y) + alphaOffset;
+        const uint8_t value = row[(corner.width() - 1) * stride];
+
+        for (int x = corner.width(); x < quadrant.width(); ++x) {
+            row[x * stride] = value;
+        }
+    }
+
+    const uint8_t *profile = image.scanLine(corner.height() - 1) + alphaOffset;
+    for (int y = corner.height(); y < quadrant.height(); ++y) {
+        uint8_t *row = image.scanLine(y) + alphaOffset;
+
+        for (int x = 0; x < quadrant.width(); ++x) {
+            row[x * stride] = profile[x * stride];
+        }
+    }
+}
+
+/**
+ * Compute the variance of three consecutive box filters.
+ *
+ * @param lobes Parameters for three box filters.
+ **/
+static inline qreal calculateLobesVariance(const std::array<BoxLobes, 3> &lobes)
 {
-    const QSize inflation = calculateBlurExtent(radius);
-    const QSize size = rect.size() + 2 * inflation;
+    // The variance of a box filter of width w is (w^2 - 1) / 12, and variances
+    // of consecutive filters add up.
+    qreal variance = 0;
+    for (const BoxLobes &lobe : lobes) {
+        const int boxSize = lobe.left + 1 + lobe.right;
+        variance += (boxSize * boxSize - 1) / 12.0;
+    }
+    return variance;
+}
+
+/**
+ * Compute the standard deviation of the gaussian that the three box filters
+ * for the given radius approximate.
+ *
+ * @param radius The blur radius.
+ **/
+static inline qreal calculateLobesStdDev(int radius)
+{
+    return qSqrt(calculateLobesVariance(computeLobes(radius)));
+}
+
+/**
+ * Compute three box filters that take a blur from a smaller radius to a larger one.
+ *
+ * Blurring twice adds up the variances, so the filters are picked to come
+ * closest to the variance the smaller radius lacks.
+ *
+ * @param sourceRadius The blur radius that has been applied already.
+ * @param radius The blur radius to end up with.
+ * @returns Parameters for three box filters.
+ **/
+static std::array<BoxLobes, 3> computeRemainingLobes(int sourceRadius, int radius)
+{
+    const int blurRadius = calculateBlurRadius(calculateBlurStdDev(radius));
+    const qreal variance = calculateLobesVariance(computeLobes(radius)) - calculateLobesVariance(computeLobes(sourceRadius));
+
+    std::array<BoxLobes, 3> lobes = splitBlurRadius(1);
+    qreal error = qAbs(calculateLobesVariance(lobes) - variance);
+    for (int candidate = 2; candidate <= blurRadius; ++candidate) {
+        const std::array<BoxLobes, 3> candidateLobes = splitBlurRadius(candidate);
+        const qreal candidateError = qAbs(calculateLobesVariance(candidateLobes) - variance);
+        if (candidateError < error) {
+            lobes = candidateLobes;
+            error = candidateError;
+        }
+    }
+    return lobes;
+}
+
+/**
+ * Approximation of the error function, the absolute error is below 5e-4, which is
+ * plenty for 8 bit alpha values.
+ **/
+static inline qreal fastErf(qreal x)
+{
+    const qreal a = qAbs(x);
+    qreal t = 1.0 + (0.278393 + (0.230389 + 0.078108 * (a * a)) * a) * a;
+    t *= t;
+    const qreal value = 1.0 - 1.0 / (t * t);
+    return x < 0 ? -value : value;
+}
+
+/**
+ * Render the alpha channel of a gaussian blurred rounded box in closed form.
+ *
+ * The horizontal integral of a blurred box has a closed form. The vertical one is
+ * integrated numerically over a few segments, each weighted with its exact gaussian
+ * mass, so rows that don't touch the rounded corners are exact and only the corners
+ * themselves are approximated. Unlike the box blur, the cost only depends on the
+ * number of rendered pixels.
+ *
+ * @param image The image to render into.
+ * @param box The box, in device pixels.
+ * @param cornerRadius The radius of the box' corners, in device pixels.
+ * @param stdDev The standard deviation of the gaussian.
+ * @param rect Specifies what part of the image to render.
+ **/
+static void renderAnalyticAlpha(QImage &image, const QRectF &box, qreal cornerRadius, qreal stdDev, const QRect &rect)
+{
+    static const int segmentCount = 8;
+
+    const int alphaOffset = alphaChannelOffset(image);
+    const int pixelStride = image.depth() >> 3;
+
+    const QPointF center = box.center();
+    const qreal halfWidth = box.width() * 0.5;
+    const qreal halfHeight = box.height() * 0.5;
+    const qreal radius = qMin(cornerRadius, qMin(halfWidth, halfHeight));
+    const qreal scale = 1.0 / (stdDev * M_SQRT2);
+
+    // Closed form of the horizontal integral across a span of the box.
+    auto integrateSpan = [scale](qreal x, qreal halfSpan) {
+        return 0.5 * (fastErf((x + halfSpan) * scale) - fastErf((x - halfSpan) * scale));
+    };
+
+    // Rows away from the corners only see the straight part of the box.
+    qreal *straightProfile = ShadowWorkspace::local().buffer<qreal>(ShadowWorkspace::ProfileBuffer, rect.width());
+    for (int i = 0; i < rect.width(); ++i) {
+        straightProfile[i] = integrateSpan(rect.x() + i + 0.5 - center.x(), halfWidth);
+    }
+
+    struct Segment {
+        qreal weight;
+        qreal halfSpan;
+    };
+
+    Segment curvedSegments[segmentCount];
+
+    for (int j = 0; j < rect.height(); ++j) {
+        const qreal y = rect.y() + j + 0.5 - center.y();
+
+        // Offsets of the gaussian that still overlap the box.
+        const qreal start = qBound(y - halfHeight, -4.0 * stdDev, y + halfHeight);
+        const qreal end = qBound(y - halfHeight, 4.0 * stdDev, y + halfHeight);
+        const qreal step = (end - start) / segmentCount;
+
+        qreal straightWeight = 0;
+        int curvedCount = 0;
+
+        qreal lowerMass = 0.5 * fastErf(start * scale);
+        for (int k = 0; k < segmentCount && step > 0; ++k) {
+            const qreal upperMass = 0.5 * fastErf((start + (k + 1) * step) * scale);
+            const qreal weight = upperMass - lowerMass;
+            lowerMass = upperMass;
+
+            const qreal boxY = y - (start + (k + 0.5) * step);
+            const qreal delta = halfHeight - radius - qAbs(boxY);
+            if (delta >= 0) {
+                straightWeight += weight;
+            } else {
+                const qreal halfSpan = halfWidth - radius + qSqrt(qMax(0.0, radius * radius - delta * delta));
+                curvedSegments[curvedCount++] = {weight, halfSpan};
+            }
+        }
+
+        uint8_t *out = image.scanLine(rect.y() + j) + rect.x() * pixelStride + alphaOffset;
+        for (int i = 0; i < rect.width(); ++i, out += pixelStride) {
+            qreal value = straightWeight * straightProfile[i];
+            if (curvedCount) {
+                const qreal x = rect.x() + i + 0.5 - center.x();
+                for (int k = 0; k < curvedCount; ++k) {
+                    value += curvedSegments[k].weight * integrateSpan(x, curvedSegments[k].halfSpan);
+                }
+            }
+            *out = static_cast<uint8_t>(qBound(0, qRound(value * 255), 255));
+        }
+    }
+}
+
+/**
+ * Coefficients of a recursive gaussian filter.
+ *
+ * See I.T. Young, L.J. van Vliet, "Recursive implementation of the Gaussian
+ * filter", Signal Processing 44 (1995) 139-151.
+ **/
+struct RecursiveGaussian
+{
+    float gain;     ///< weight of the input
+    float feedback1; ///< weight of the previous output
+    float feedback2; ///< weight of the output before the previous one
+    float feedback3; ///< weight of the output three samples back
+};
+
+static RecursiveGaussian computeRecursiveGaussian(qreal stdDev)
+{
+    const qreal q = stdDev >= 2.5
+        ? 0.98711 * stdDev - 0.96330
+        : 3.97156 - 4.14554 * qSqrt(1.0 - 0.26891 * stdDev);
+    const qreal q2 = q * q;
+    const qreal q3 = q2 * q;
+
+    const qreal b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    const qreal b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+    const qreal b2 = -(1.4281 * q2 + 1.26661 * q3);
+    const qreal b3 = 0.422205 * q3;
+
+    return {
+        static_cast<float>(1.0 - (b1 + b2 + b3) / b0),
+        static_cast<float>(b1 / b0),
+        static_cast<float>(b2 / b0),
+        static_cast<float>(b3 / b0)
+    };
+}
+
+/**
+ * Filter columns of a block with a recursive gaussian, forwards and backwards.
+ *
+ * The block is processed row by row, so that the inner loops run over adjacent
+ * columns and vectorize. Samples past the edges are taken to repeat the first
+ * and the last row.
+ *
+ * @param data The first row of the block.
+ * @param stride The number of values from one row to the next one.
+ * @param begin The first column to filter.
+ * @param end One past the last column to filter.
+ * @param height The number of rows.
+ * @param filter The filter coefficients.
+ * @param edge Scratch space for one row.
+ **/
+static void recursiveGaussianColumns(float *data, int stride, int begin, int end, int height,
+                                     const RecursiveGaussian &filter, float *edge)
+{
+    const int width = end - begin;
+    auto row = [&](int y) {
+        return data + y * stride + begin;
+    };
+
+    // Causal pass, the output of a constant input is that constant.
+    std::memcpy(edge, row(0), width * sizeof(float));
+    for (int y = 0; y < height; ++y) {
+        float *out = row(y);
+        const float *previous1 = y >= 1 ? row(y - 1) : edge;
+        const float *previous2 = y >= 2 ? row(y - 2) : edge;
+        const float *previous3 = y >= 3 ? row(y - 3) : edge;
+
+        for (int x = 0; x < width; ++x) {
+            out[x] = filter.gain * out[x] + filter.feedback1 * previous1[x]
+                + filter.feedback2 * previous2[x] + filter.feedback3 * previous3[x];
+        }
+    }
+
+    // Anti-causal pass.
+    std::memcpy(edge, row(height - 1), width * sizeof(float));
+    for (int y = height - 1; y >= 0; --y) {
+        float *out = row(y);
+        const float *next1 = y + 1 < height ? row(y + 1) : edge;
+        const float *next2 = y + 2 < height ? row(y + 2) : edge;
+        const float *next3 = y + 3 < height ? row(y + 3) : edge;
+
+        for (int x = 0; x < width; ++x) {
+            out[x] = filter.gain * out[x] + filter.feedback1 * next1[x]
+                + filter.feedback2 * next2[x] + filter.feedback3 * next3[x];
+        }
+    }
+}
+
+/**
+ * Blur the alpha channel of a given image with a recursive gaussian.
+ *
+ * Unlike the box blur, the cost doesn't depend on the radius at all and the
+ * result doesn't depend on how the radius splits into box lobes.
+ *
+ * @param image The input image.
+ * @param stdDev The standard deviation of the gaussian.
+ * @param rect Specifies what part of the image to blur.
+ **/
+static void recursiveGaussianAlpha(QImage &image, qreal stdDev, const QRect &rect)
+{
+    const RecursiveGaussian filter = computeRecursiveGaussian(stdDev);
+
+    const int alphaOffset = alphaChannelOffset(image);
+    const int pixelStride = image.depth() >> 3;
+    const int width = rect.width();
+    const int height = rect.height();
+
+    // Rows are filtered as the columns of the transposed block.
+    ShadowWorkspace &workspace = ShadowWorkspace::local();
+    float *transposedData = workspace.buffer<float>(ShadowWorkspace::TransposedBlockBuffer, width * height);
+    float *blockData = workspace.buffer<float>(ShadowWorkspace::BlockBuffer, width * height);
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *in = image.constScanLine(rect.y() + y) + rect.x() * pixelStride + alphaOffset;
+        for (int x = 0; x < width; ++x) {
+            transposedData[x * height + y] = in[x * pixelStride];
+        }
+    }
+
+    parallelFor(height, s_linesPerTask, [&](int begin, int end) {
+        float *edge = ShadowWorkspace::local().buffer<float>(ShadowWorkspace::EdgeBuffer, end - begin);
+        recursiveGaussianColumns(transposedData, height, begin, end, width, filter, edge);
+    });
+
+    for (int x = 0; x < width; ++x) {
+        const float *in = transposedData + x * height;
+        for (int y = 0; y < height; ++y) {
+            blockData[y * width + x] = in[y];
+        }
+    }
+
+    parallelFor(width, s_linesPerTask, [&](int begin, int end) {
+        float *edge = ShadowWorkspace::local().buffer<float>(ShadowWorkspace::EdgeBuffer, end - begin);
+        recursiveGaussianColumns(blockData, width, begin, end, height, filter, edge);
+    });
+
+    for (int y = 0; y < height; ++y) {
+        uint8_t *out = image.scanLine(rect.y() + y) + rect.x() * pixelStride + alphaOffset;
+        const float *in = blockData + y * width;
+        for (int x = 0; x < width; ++x) {
+            out[x * pixelStride] = static_cast<uint8_t>(qBound(0, qRound(in[x]), 255));
+        }
+    }
+}
+
+/**
+ * Multiply all four channels of a premultiplied pixel by @p alpha, divided by 255.
+ *
+ * This is the same approximation the raster paint engine uses, so that
+ * compositeAlphaMask gives the same result as QPainter.
+ **/
+static inline uint byteMul(uint x, uint alpha)
+{
+    uint t = (x & 0xff00ff) * alpha;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+
+    x = ((x >> 8) & 0xff00ff) * alpha;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+
+    return x | t;
+}
+
+/**
+ * Fill a palette with the given color at each alpha value of a mask.
+ *
+ * Filling the mask with the color in SourceIn mode multiplies the premultiplied
+ * color by the alpha of the mask, rounded the same way as QPainter does.
+ *
+ * @param palette Receives 256 premultiplied pixels.
+ * @param color The color of the shadow.
+ **/
+static inline void fillTintPalette(QRgb *palette, const QColor &color)
+{
+    const QRgb premultiplied = qPremultiply(color.rgba());
+    for (int alpha = 0; alpha < 256; ++alpha) {
+        palette[alpha] = byteMul(premultiplied, alpha);
+    }
+}
+
+/**
+ * Draw an alpha mask in the given color onto an image.
+ *
+ * Same as drawing the mask tinted by tintAlphaMask unscaled with QPainter in
+ * SourceOver mode, without an intermediate image or a painter.
+ *
+ * @param canvas The premultiplied destination image.
+ * @param position Where the top-left corner of the mask goes, in device pixels.
+ * @param mask The 8-bit alpha mask.
+ * @param color The color of the shadow.
+ **/
+static void compositeAlphaMask(QImage &canvas, const QPoint &position, const QImage &mask, const QColor &color)
+{
+    QRgb palette[256];
+    fillTintPalette(palette, color);
+
+    const QRect target = QRect(position, mask.size()).intersected(canvas.rect());
+
+    for (int y = target.top(); y <= target.bottom(); ++y) {
+        const uint8_t *in = mask.constScanLine(y - position.y()) + (target.left() - position.x());
+        QRgb *out = reinterpret_cast<QRgb *>(canvas.scanLine(y)) + target.left();
+
+        for (int x = 0; x < target.width(); ++x) {
+            const QRgb source = palette[in[x]];
+            if (qAlpha(source) == 255) {
+                out[x] = source;
+            } else if (source) {
+                out[x] = source + byteMul(out[x], qAlpha(~source));
+            }
+        }
+    }
+}
+
+/**
+ * Expand an alpha mask into a shadow of the given color.
+ *
+ * This is what filling the mask with the color in SourceIn mode does, except
+ * that the mask only has to be read once and no ARGB image is needed before.
+ *
+ * @param mask The 8-bit alpha mask.
+ * @param color The color of the shadow.
+ * @returns The premultiplied shadow image.
+ **/
+static QImage tintAlphaMask(const QImage &mask, const QColor &color)
+{
+    QImage shadow(mask.size(), QImage::Format_ARGB32_Premultiplied);
+    shadow.setDevicePixelRatio(mask.devicePixelRatioF());
+
+    QRgb palette[256];
+    fillTintPalette(palette, color);
+
+    for (int y = 0; y < mask.height(); ++y) {
+        const uint8_t *in = mask.constScanLine(y);
+        QRgb *out = reinterpret_cast<QRgb *>(shadow.scanLine(y));
+
+        for (int x = 0; x < mask.width(); ++x) {
+            out[x] = palette[in[x]];
+        }
+    }
+
+    return shadow;
+}
 
-    const qreal dpr = painter->device()->devicePixelRatioF();
+/**
+ * Parameters that fully describe the alpha mask of a shadow.
+ **/
+struct ShadowMaskKey
+{
+    QSize boxSize;
+    qreal borderRadius;
+    int radius;
+    qreal devicePixelRatio;
+    BoxShadowRenderer::Method method;
+    int sourceRadius; ///< radius of the mask this one continues from, see continueMask(), or 0
 
-    QImage shadow(size * dpr, QImage::Format_ARGB32_Premultiplied);
-    shadow.setDevicePixelRatio(dpr);
-    shadow.fill(Qt::transparent);
+    bool operator==(const ShadowMaskKey &other) const
+    {
+        return boxSize == other.boxSize
+            && borderRadius == other.borderRadius
+            && radius == other.radius
+            && devicePixelRatio == other.devicePixelRatio
+            && method == other.method
+            && sourceRadius == other.sourceRadius;
+    }
+};
+
+static inline uint qHash(const ShadowMaskKey &key, uint seed = 0)
+{
+    uint hash = seed;
+    hash = 31 * hash + ::qHash(key.boxSize.width());
+    hash = 31 * hash + ::qHash(key.boxSize.height());
+    hash = 31 * hash + ::qHash(key.borderRadius);
+    hash = 31 * hash + ::qHash(key.radius);
+    hash = 31 * hash + ::qHash(key.devicePixelRatio);
+    hash = 31 * hash + ::qHash(static_cast<int>(key.method));
+    hash = 31 * hash + ::qHash(key.sourceRadius);
+    return hash;
+}
+
+// Upper bound for the memory used by cached masks, in bytes. All the shadows of
+// the decoration and of a couple of previews in the settings fit in here.
+static const int s_maxCachedMaskBytes = 8 * 1024 * 1024;
+
+// Masks are rendered on the threads of the shadow pool too.
+static QMutex s_maskCacheMutex;
+
+static QCache<ShadowMaskKey, QImage> &maskCache()
+{
+    static QCache<ShadowMaskKey, QImage> cache(s_maxCachedMaskBytes);
+    return cache;
+}
+
+/**
+ * Layout of the alpha mask of a shadow.
+ **/
+struct MaskGeometry
+{
+    QSize size;       ///< size of the mask, in device pixels
+    QRect boxRect;    ///< the box, in logical pixels
+    qreal xRadius;    ///< horizontal radius of box' corners, relative to its width
+    qreal yRadius;    ///< vertical radius of box' corners, relative to its height
+    QSize quadrant;   ///< the top-left quadrant, in device pixels
+    int scaledRadius; ///< the blur radius, in device pixels
+    qreal stdDev;     ///< standard deviation of the blur, in device pixels
+    QRect blurRect;   ///< the corner of the quadrant that is blurred, in device pixels
+};
+
+static MaskGeometry calculateMaskGeometry(const QSize &boxSize, qreal borderRadius, int radius, qreal dpr)
+{
+    MaskGeometry geometry;
 
-    QRect boxRect(QPoint(0, 0), rect.size());
-    boxRect.moveCenter(QRect(QPoint(0, 0), size).center());
+    const QSize inflation = calculateBlurExtent(radius);
+    const QSize size = boxSize + 2 * inflation;
+    geometry.size = size * dpr;
 
-    const qreal xRadius = 2.0 * borderRadius / boxRect.width();
-    const qreal yRadius = 2.0 * borderRadius / boxRect.height();
+    geometry.boxRect = QRect(QPoint(0, 0), boxSize);
+    geometry.boxRect.moveCenter(QRect(QPoint(0, 0), size).center());
 
-    QPainter shadowPainter;
-    shadowPainter.begin(&shadow);
-    shadowPainter.setRenderHint(QPainter::Antialiasing);
-    shadowPainter.setPen(Qt::NoPen);
-    shadowPainter.setBrush(Qt::black);
-    shadowPainter.drawRoundedRect(boxRect, xRadius, yRadius);
-    shadowPainter.end();
+    geometry.xRadius = 2.0 * borderRadius / geometry.boxRect.width();
+    geometry.yRadius = 2.0 * borderRadius / geometry.boxRect.height();
 
     // Because the shadow texture is symmetrical, that's enough to blur
     // only the top-left quadrant and then mirror it.
-    const QRect blurRect(0, 0, qCeil(shadow.width() * 0.5), qCeil(shadow.height() * 0.5));
+    geometry.quadrant = QSize(qCeil(geometry.size.width() * 0.5), qCeil(geometry.size.height() * 0.5));
+    geometry.scaledRadius = qRound(radius * dpr);
+    geometry.stdDev = calculateLobesStdDev(geometry.scaledRadius);
+
+    // Only the corner of the quadrant has to be blurred, past it the box is flat
+    // (give or take a pixel of antialiasing) for at least the blur extent, so the
+    // straight edges can be copied from the last row and column of the corner.
+    const int blurExtent = calculateBlurExtent(geometry.scaledRadius).width();
+    const QSize corner(qCeil((geometry.boxRect.x() + geometry.xRadius) * dpr) + blurExtent + 2,
+                       qCeil((geometry.boxRect.y() + geometry.yRadius) * dpr) + blurExtent + 2);
+    geometry.blurRect = QRect(QPoint(0, 0), corner.boundedTo(geometry.quadrant));
+
+    return geometry;
+}
+
+/**
+ * Returns the block the recursive gaussian filters to blur the corner of a mask.
+ *
+ * @param geometry The layout of the mask.
+ * @param stdDev The standard deviation of the recursive gaussian.
+ **/
+static QRect recursiveFilterRect(const MaskGeometry &geometry, qreal stdDev)
+{
+    // The recursive gaussian has no finite support, whatever is past the edges
+    // of the filtered block is taken to repeat them. Filter the box itself for
+    // another 4 sigmas, even past the center, so that the corner isn't pulled
+    // towards its clamped edges.
+    const int margin = qCeil(4.0 * stdDev);
+    return QRect(QPoint(0, 0), (geometry.blurRect.size() + QSize(margin, margin)).boundedTo(geometry.size));
+}
+
+/**
+ * Render the blurred alpha mask of a shadow.
+ *
+ * @param boxSize The size of the box.
+ * @param borderRadius The radius of box' corners.
+ * @param radius The blur radius.
+ * @param dpr The device pixel ratio of the mask.
+ * @param method The method used to generate the mask.
+ **/
+static QImage generateMask(const QSize &boxSize, qreal borderRadius, int radius, qreal dpr, BoxShadowRenderer::Method method)
+{
+    const MaskGeometry geometry = calculateMaskGeometry(boxSize, borderRadius, radius, dpr);
+
+    // The shadow is built as an alpha mask first, the blur only has to move a
+    // quarter of the data around that way.
+    QImage mask(geometry.size, QImage::Format_Alpha8);
+    mask.setDevicePixelRatio(dpr);
+    mask.fill(0);
+
+    if (method == BoxShadowRenderer::Method::Analytic && geometry.scaledRadius >= 2) {
+        // Same box and corners that QPainter rasterizes for the box blur.
+        const QRectF box(QPointF(geometry.boxRect.topLeft()) * dpr, QSizeF(geometry.boxRect.size()) * dpr);
+        renderAnalyticAlpha(mask, box, qMin(geometry.xRadius, geometry.yRadius) * dpr, geometry.stdDev, geometry.blurRect);
+    } else {
+        QPainter shadowPainter;
+        shadowPainter.begin(&mask);
+        shadowPainter.setRenderHint(QPainter::Antialiasing);
+        shadowPainter.setPen(Qt::NoPen);
+        shadowPainter.setBrush(Qt::black);
+        shadowPainter.drawRoundedRect(geometry.boxRect, geometry.xRadius, geometry.yRadius);
+        shadowPainter.end();
+
+        if (method == BoxShadowRenderer::Method::Recursive && geometry.scaledRadius >= 2) {
+            recursiveGaussianAlpha(mask, geometry.stdDev, recursiveFilterRect(geometry, geometry.stdDev));
+        } else {
+            boxBlurAlpha(mask, geometry.scaledRadius, geometry.blurRect);
+        }
+    }
+
+    extendCorner(mask, geometry.blurRect.size(), geometry.quadrant);
+
+    mirrorTopLeftQuadrant(mask);
+
+    return mask;
+}
+
+/**
+ * Returns whether the mask of a shadow can be rendered from the mask of a smaller
+ * radius around the same box, see continueMask().
+ *
+ * @param sourceRadius The blur radius of the smaller mask.
+ * @param sourceMethod The method the smaller mask is generated with.
+ * @param radius The blur radius.
+ * @param method The method used to generate the mask.
+ * @param dpr The device pixel ratio of both masks.
+ **/
+static bool canContinueMask(int sourceRadius, BoxShadowRenderer::Method sourceMethod,
+                            int radius, BoxShadowRenderer::Method method, qreal dpr)
+{
+    // The analytic shadow doesn't blur anything, so there is nothing to share.
+    if (sourceMethod != BoxShadowRenderer::Method::BoxBlur
+        || (method != BoxShadowRenderer::Method::BoxBlur && method != BoxShadowRenderer::Method::Recursive)) {
+        return false;
+    }
+
+    const int scaledSourceRadius = qRound(sourceRadius * dpr);
     const int scaledRadius = qRound(radius * dpr);
-    boxBlurAlpha(shadow, scaledRadius, blurRect);
-    mirrorTopLeftQuadrant(shadow);
+    if (scaledSourceRadius < 2 || calculateLobesStdDev(scaledRadius) <= calculateLobesStdDev(scaledSourceRadius)) {
+        return false;
+    }
+
+    // The smaller mask has to land on whole device pixels of the larger one.
+    const qreal offset = (calculateBlurExtent(radius).width() - calculateBlurExtent(sourceRadius).width()) * dpr;
+    return qFuzzyIsNull(offset - qRound(offset));
+}
+
+/**
+ * Render the blurred alpha mask of a shadow from the mask of a smaller radius
+ * around the same box.
+ *
+ * The smaller mask is blurred already. It is placed on the larger mask and only
+ * blurred by the variance it lacks, with three more box filters or a narrower
+ * recursive gaussian, which saves rasterizing the box a second time. The result
+ * stays within a few alpha levels of generateMask().
+ *
+ * @param source The smaller mask, @p sourceRadius and @p radius must pass canContinueMask().
+ * @param sourceRadius The blur radius of @p source.
+ * @param boxSize The size of the box.
+ * @param borderRadius The radius of box' corners.
+ * @param radius The blur radius.
+ * @param dpr The device pixel ratio of both masks.
+ * @param method The method used to generate the mask.
+ **/
+static QImage continueMask(const QImage &source, int sourceRadius, const QSize &boxSize, qreal borderRadius,
+                           int radius, qreal dpr, BoxShadowRenderer::Method method)
+{
+    const MaskGeometry geometry = calculateMaskGeometry(boxSize, borderRadius, radius, dpr);
 
-    // Give the shadow a tint of the desired color.
-    shadowPainter.begin(&shadow);
-    shadowPainter.setCompositionMode(QPainter::CompositionMode_SourceIn);
-    shadowPainter.fillRect(shadow.rect(), color);
-    shadowPainter.end();
+    QImage mask(geometry.size, QImage::Format_Alpha8);
+    mask.setDevicePixelRatio(dpr);
+    mask.fill(0);
 
-    // Actually, present the shadow.
-    QRect shadowRect = shadow.rect();
-    shadowRect.setSize(shadowRect.size() / dpr);
-    shadowRect.moveCenter(rect.center() + offset);
-    painter->drawImage(shadowRect, shadow);
+    const int offset = qRound((calculateBlurExtent(radius).width() - calculateBlurExtent(sourceRadius).width()) * dpr);
+    const QRect sourceRect = QRect(QPoint(offset, offset), source.size()).intersected(mask.rect());
+    for (int y = sourceRect.top(); y <= sourceRect.bottom(); ++y) {
+        std::memcpy(mask.scanLine(y) + sourceRect.x(), source.constScanLine(y - offset) + sourceRect.x() - offset,
+                    sourceRect.width());
+    }
+
+    const int scaledSourceRadius = qRound(sourceRadius * dpr);
+    if (method == BoxShadowRenderer::Method::Recursive) {
+        const qreal sourceStdDev = calculateLobesStdDev(scaledSourceRadius);
+        const qreal stdDev = qSqrt(geometry.stdDev * geometry.stdDev - sourceStdDev * sourceStdDev);
+
+        // The block is sized for the whole blur, the source has spread the box already.
+        recursiveGaussianAlpha(mask, stdDev, recursiveFilterRect(geometry, geometry.stdDev));
+    } else {
+        boxBlurAlpha(mask, computeRemainingLobes(scaledSourceRadius, geometry.scaledRadius), geometry.blurRect);
+    }
+
+    extendCorner(mask, geometry.blurRect.size(), geometry.quadrant);
+
+    mirrorTopLeftQuadrant(mask);
+
+    return mask;
 }
 
 void BoxShadowRenderer::setBoxSize(const QSize &size)
@@ -302,6 +1239,11 @@ void BoxShadowRenderer::setDevicePixelRatio(qreal dpr)
     m_dpr = dpr;
 }
 
+void BoxShadowRenderer::setMethod(Method method)
+{
+    m_method = method;
+}
+
 void BoxShadowRenderer::addShadow(const QPoint &offset, int radius, const QColor &color)
 {
     Shadow shadow = {};
@@ -323,6 +1265,8 @@ QImage BoxShadowRenderer::render() const
             calculateMinimumShadowTextureSize(m_boxSize, shadow.radius, shadow.offset));
     }
 
+    // The canvas is handed over to the caller, who usually paints on it. Any
+    // reference kept here would make the caller's painter detach and copy it.
     QImage canvas(canvasSize * m_dpr, QImage::Format_ARGB32_Premultiplied);
     canvas.setDevicePixelRatio(m_dpr);
     canvas.fill(Qt::transparent);
@@ -330,15 +1274,209 @@ QImage BoxShadowRenderer::render() const
     QRect boxRect(QPoint(0, 0), m_boxSize);
     boxRect.moveCenter(QRect(QPoint(0, 0), canvasSize).center());
 
-    QPainter painter(&canvas);
+    QVarLengthArray<int, 8> radii;
     for (const Shadow &shadow : qAsConst(m_shadows)) {
-        renderShadow(&painter, boxRect, m_borderRadius, shadow.offset, shadow.radius, shadow.color);
+        radii.append(shadow.radius);
+    }
+
+    // Only compositing the shadows has to happen in order.
+    QVarLengthArray<QImage, 8> masks(m_shadows.size());
+    renderMasks(m_boxSize, m_borderRadius, radii.constData(), radii.size(), m_dpr, m_method, masks.data());
+
+    // On integer scale factors, masks land on whole device pixels and can be
+    // composited directly, otherwise QPainter has to resample them.
+    const int scale = qRound(m_dpr);
+    const bool integerScale = m_dpr == scale;
+
+    QPainter painter;
+    if (!integerScale) {
+        painter.begin(&canvas);
+    }
+
+    for (int i = 0; i < m_shadows.size(); ++i) {
+        const Shadow &shadow = m_shadows.at(i);
+        const QImage &mask = masks.at(i);
+
+        QRect shadowRect(QPoint(0, 0), mask.size() / m_dpr);
+        shadowRect.moveCenter(boxRect.center() + shadow.offset);
+
+        if (integerScale) {
+            compositeAlphaMask(canvas, shadowRect.topLeft() * scale, mask, shadow.color);
+        } else {
+            painter.drawImage(shadowRect, tintAlphaMask(mask, shadow.color));
+        }
+    }
+
+    if (!integerScale) {
+        painter.end();
     }
-    painter.end();
 
     return canvas;
 }
 
+/**
+ * Returns the cached mask for the given parameters, or a null image.
+ **/
+static QImage cachedMask(const ShadowMaskKey &key)
+{
+    QMutexLocker locker(&s_maskCacheMutex);
+    if (const QImage *cached = maskCache().object(key)) {
+        return *cached;
+    }
+    return {};
+}
+
+/**
+ * Returns the method that generates the mask of a shadow.
+ **/
+static inline BoxShadowRenderer::Method resolveMethod(BoxShadowRenderer::Method method, int radius, qreal dpr)
+{
+    return method == BoxShadowRenderer::Method::Automatic ? BoxShadowRenderer::preferredMethod(radius, dpr) : method;
+}
+
+/**
+ * Returns the mask for the given parameters, from the caches if possible.
+ *
+ * @param key The parameters of the mask.
+ * @param source The mask of radius @c key.sourceRadius, if that is set.
+ **/
+static QImage renderMask(const ShadowMaskKey &key, const QImage &source)
+{
+    const QImage cached = cachedMask(key);
+    if (!cached.isNull()) {
+        return cached;
+    }
+
+    // Masks rendered by a previous run are only a file mapping away.
+    QByteArray diskKey = QByteArray::number(key.boxSize.width()) + ' ' + QByteArray::number(key.boxSize.height())
+        + ' ' + QByteArray::number(key.borderRadius, 'g', 17) + ' ' + QByteArray::number(key.radius)
+        + ' ' + QByteArray::number(key.devicePixelRatio, 'g', 17) + ' ' + QByteArray::number(static_cast<int>(key.method));
+    if (key.sourceRadius) {
+        diskKey += " from " + QByteArray::number(key.sourceRadius);
+    }
+
+    const QSize maskSize = (key.boxSize + 2 * calculateBlurExtent(key.radius)) * key.devicePixelRatio;
+
+    // Concurrent misses for the same mask may both render it, the result is the same.
+    QImage mask = ShadowDiskCache::load(diskKey, maskSize, key.devicePixelRatio);
+    if (mask.isNull()) {
+        if (key.sourceRadius) {
+            mask = continueMask(source, key.sourceRadius, key.boxSize, key.borderRadius, key.radius,
+                                key.devicePixelRatio, key.method);
+        } else {
+            mask = generateMask(key.boxSize, key.borderRadius, key.radius, key.devicePixelRatio, key.method);
+        }
+        ShadowDiskCache::store(diskKey, mask);
+    }
+
+    QMutexLocker locker(&s_maskCacheMutex);
+    maskCache().insert(key, new QImage(mask), mask.bytesPerLine() * mask.height());
+
+    return mask;
+}
+
+QImage BoxShadowRenderer::renderMask(const QSize &boxSize, qreal borderRadius, int radius, qreal dpr, Method method)
+{
+    return Breeze::renderMask({boxSize, borderRadius, radius, dpr, resolveMethod(method, radius, dpr), 0}, {});
+}
+
+QVector<QImage> BoxShadowRenderer::renderMasks(const QSize &boxSize, qreal borderRadius, const QVector<int> &radii,
+                                               qreal dpr, Method method)
+{
+    QVector<QImage> masks(radii.size());
+    renderMasks(boxSize, borderRadius, radii.constData(), radii.size(), dpr, method, masks.data());
+    return masks;
+}
+
+void BoxShadowRenderer::renderMasks(const QSize &boxSize, qreal borderRadius, const int *radii, int count,
+                                    qreal dpr, Method method, QImage *masks)
+{
+    // The smallest radius that is box blurred is the source of the larger ones.
+    int sourceRadius = 0;
+    for (int i = 0; i < count; ++i) {
+        if (resolveMethod(method, radii[i], dpr) == Method::BoxBlur && (!sourceRadius || radii[i] < sourceRadius)) {
+            sourceRadius = radii[i];
+        }
+    }
+
+    // Cached masks are picked up right away, without involving other threads.
+    QVarLengthArray<ShadowMaskKey, 8> keys(count);
+    bool missing = false;
+    for (int i = 0; i < count; ++i) {
+        keys[i] = {boxSize, borderRadius, radii[i], dpr, resolveMethod(method, radii[i], dpr), 0};
+        if (sourceRadius && canContinueMask(sourceRadius, Method::BoxBlur, radii[i], keys[i].method, dpr)) {
+            keys[i].sourceRadius = sourceRadius;
+        }
+
+        masks[i] = cachedMask(keys[i]);
+        missing |= masks[i].isNull();
+    }
+
+    if (!missing) {
+        return;
+    }
+
+    // Masks that don't continue from another one are rendered first, the source
+    // among them, then the masks that continue from the source. Within a stage
+    // the masks don't depend on each other and are rendered in parallel.
+    // Duplicate radii are only rendered once.
+    QVarLengthArray<ShadowMaskKey, 8> stageKeys[2];
+    for (int i = 0; i < count; ++i) {
+        if (!masks[i].isNull()) {
+            continue;
+        }
+
+        if (keys[i].sourceRadius) {
+            const ShadowMaskKey sourceKey = {boxSize, borderRadius, sourceRadius, dpr, Method::BoxBlur, 0};
+            if (!stageKeys[0].contains(sourceKey)) {
+                stageKeys[0].append(sourceKey);
+            }
+        }
+
+        QVarLengthArray<ShadowMaskKey, 8> &stage = stageKeys[keys[i].sourceRadius ? 1 : 0];
+        if (!stage.contains(keys[i])) {
+            stage.append(keys[i]);
+        }
+    }
+
+    QVarLengthArray<QImage, 8> stageMasks[2];
+    QImage source;
+    for (int stage = 0; stage < 2; ++stage) {
+        const QVarLengthArray<ShadowMaskKey, 8> &currentKeys = stageKeys[stage];
+        stageMasks[stage].resize(currentKeys.size());
+
+        QImage *stageData = stageMasks[stage].data();
+        parallelFor(currentKeys.size(), 1, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                stageData[i] = Breeze::renderMask(currentKeys.at(i), source);
+            }
+        });
+
+        if (stage == 0 && !stageKeys[1].isEmpty()) {
+            source = stageMasks[0].at(currentKeys.indexOf({boxSize, borderRadius, sourceRadius, dpr, Method::BoxBlur, 0}));
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (masks[i].isNull()) {
+            const int stage = keys[i].sourceRadius ? 1 : 0;
+            masks[i] = stageMasks[stage].at(stageKeys[stage].indexOf(keys[i]));
+        }
+    }
+}
+
+BoxShadowRenderer::Method BoxShadowRenderer::preferredMethod(int radius, qreal dpr)
+{
+    // Thresholds measured on the corners of the shadow presets.
+    const int scaledRadius = qRound(radius * dpr);
+    if (scaledRadius >= 64) {
+        return Method::Analytic;
+    } else if (scaledRadius > 32) {
+        return Method::Recursive;
+    }
+    return Method::BoxBlur;
+}
+
 QSize BoxShadowRenderer::calculateMinimumBoxSize(int radius)
 {
     const QSize blurExtent = calculateBlurExtent(radius);
@@ -350,4 +1488,55 @@ QSize BoxShadowRenderer::calculateMinimumShadowTextureSize(const QSize &boxSize,
     return boxSize + 2 * calculateBlurExtent(radius) + QSize(qAbs(offset.x()), qAbs(offset.y()));
 }
 
+QSize BoxShadowRenderer::calculateNineSliceBoxSize(int radius, const QPoint &offset, qreal borderRadius)
+{
+    // The corners of the (offset) box, and everything the blur spreads them to,
+    // must stay on their side of the center pixel.
+    const int cornerSize = qCeil(borderRadius);
+    const QSize cornerExtent = calculateBlurExtent(radius)
+        + QSize(cornerSize + qAbs(offset.x()), cornerSize + qAbs(offset.y()));
+    return 2 * cornerExtent + QSize(1, 1);
+}
+
+namespace ShadowMask
+{
+
+QImage generate(const QSize &boxSize, qreal borderRadius, int radius, qreal dpr, BoxShadowRenderer::Method method)
+{
+    return generateMask(boxSize, borderRadius, radius, dpr, resolveMethod(method, radius, dpr));
+}
+
+QImage generateFrom(const QImage &source, int sourceRadius, const QSize &boxSize, qreal borderRadius, int radius,
+                    qreal dpr, BoxShadowRenderer::Method method)
+{
+    method = resolveMethod(method, radius, dpr);
+    if (!canContinueMask(sourceRadius, BoxShadowRenderer::Method::BoxBlur, radius, method, dpr)) {
+        return {};
+    }
+    return continueMask(source, sourceRadius, boxSize, borderRadius, radius, dpr, method);
+}
+
+void boxBlur(QImage &image, int radius, const QRect &rect, VerticalPass verticalPass)
+{
+    boxBlurAlpha(image, radius, rect, verticalPass == VerticalPass::Tiled);
+}
+
+void boxBlurRow(const uint8_t *src, int srcStep, uint8_t *dst, int dstStep, int length, const BoxLobes &lobes)
+{
+    // the input step is the horizontal one, the output step the vertical one
+    boxBlurRowAlpha(src, dst, length, srcStep, dstStep, lobes, false, true);
+}
+
+void extendCorner(QImage &image, const QSize &corner, const QSize &quadrant)
+{
+    Breeze::extendCorner(image, corner, quadrant);
+}
+
+void mirrorTopLeftQuadrant(QImage &image)
+{
+    Breeze::mirrorTopLeftQuadrant(image);
+}
+
+} // namespace ShadowMask
+
 } // namespace Breeze
@@ -26,6 +26,7 @@
 #include <QImage>
 #include <QPoint>
 #include <QSize>
+#include <QVector>
 
 namespace Breeze
 {
@@ -35,6 +36,32 @@ class BREEZECOMMON_EXPORT BoxShadowRenderer
 public:
     // Compiler generated constructors & destructor are fine.
 
+    /**
+     * How shadows are generated.
+     **/
+    enum class Method {
+        /**
+         * Rasterize the box and blur it with three box filters. The cost grows
+         * with the size of the texture and hence with the blur radius.
+         **/
+        BoxBlur,
+        /**
+         * Evaluate a gaussian blurred rounded box in closed form. The result is
+         * a close match of BoxBlur, but the cost only depends on the texture size.
+         **/
+        Analytic,
+        /**
+         * Rasterize the box and blur it with a recursive gaussian filter. The
+         * cost per pixel doesn't depend on the blur radius and the falloff is
+         * smoother than with BoxBlur, which shows on radii above ~32 pixels.
+         **/
+        Recursive,
+        /**
+         * Pick one of the above for each shadow, see preferredMethod().
+         **/
+        Automatic
+    };
+
     /**
      * Set the size of the box.
      * @param size The size of the box.
@@ -53,6 +80,12 @@ public:
      **/
     void setDevicePixelRatio(qreal dpr);
 
+    /**
+     * Set the method used to generate shadows.
+     * @param method The method, Method::BoxBlur by default.
+     **/
+    void setMethod(Method method);
+
     /**
      * Add a shadow.
      * @param offset The offset of the shadow.
@@ -63,9 +96,87 @@ public:
 
     /**
      * Render the shadow.
+     *
+     * Scratch memory is kept across calls. When all masks are cached and the
+     * device pixel ratio is an integer, the returned image is the only memory
+     * that rendering the same shadow again allocates. The image isn't shared
+     * with anything else, so painting on it doesn't copy it.
      **/
     QImage render() const;
 
+    /**
+     * Render the blurred alpha mask of a single shadow.
+     *
+     * The mask only depends on the geometry of the shadow, so masks are cached
+     * and shadows that only differ in color or strength share one. Giving the
+     * mask its color is a single pass over it, which is all render() has to do
+     * when nothing but the colors of the shadows changed.
+     *
+     * @param boxSize The size of the box.
+     * @param borderRadius The radius of box' corners, in pixels.
+     * @param radius The blur radius.
+     * @param dpr The device pixel ratio of the mask.
+     * @param method The method used to generate the mask.
+     * @returns A Format_Alpha8 image of the shadow, centered on the box.
+     *
+     * This function is thread-safe.
+     **/
+    static QImage renderMask(const QSize &boxSize, qreal borderRadius, int radius, qreal dpr,
+                             Method method = Method::BoxBlur);
+
+    /**
+     * Render the blurred alpha masks of several shadows around the same box.
+     *
+     * This is renderMask() for a set of blur radii, as needed for the layers of
+     * a shadow. The smallest radius that is box blurred is rendered first, and
+     * larger box blurred or recursive masks continue from it: its mask is placed
+     * on theirs and only blurred by what the smaller radius lacks, instead of
+     * rasterizing and blurring the box again. These masks stay within a few alpha
+     * levels of renderMask(). Where a larger mask doesn't line up with the source
+     * on whole device pixels, it is rendered on its own. Masks that don't depend
+     * on each other are rendered in parallel, and radii that are requested more
+     * than once are only rendered once.
+     *
+     * @param boxSize The size of the box.
+     * @param borderRadius The radius of box' corners, in pixels.
+     * @param radii The blur radii.
+     * @param dpr The device pixel ratio of the masks.
+     * @param method The method used to generate the masks.
+     * @returns The masks, in the order of @p radii.
+     *
+     * This function is thread-safe.
+     **/
+    static QVector<QImage> renderMasks(const QSize &boxSize, qreal borderRadius, const QVector<int> &radii, qreal dpr,
+                                       Method method = Method::BoxBlur);
+
+    /**
+     * Overload of renderMasks() that writes to caller provided storage.
+     *
+     * Unlike the other overload, this doesn't allocate anything if all masks
+     * are cached already.
+     *
+     * @param radii The blur radii.
+     * @param count The number of radii.
+     * @param masks Receives @p count masks, in the order of @p radii.
+     **/
+    static void renderMasks(const QSize &boxSize, qreal borderRadius, const int *radii, int count, qreal dpr,
+                            Method method, QImage *masks);
+
+    /**
+     * Returns the method Method::Automatic resolves to for a shadow.
+     *
+     * The box blur is the cheapest for small radii. Above 32 device pixels, the
+     * kinks of its three box lobes start to show in the falloff and the recursive
+     * gaussian takes over, at a few times the cost of the box blur. From a blur
+     * radius of 64 device pixels on, the block the recursive gaussian filters
+     * gets too large, and the analytic shadow is evaluated over the corner
+     * instead. Both stay within a few alpha levels of the box blur.
+     *
+     * @param radius The blur radius.
+     * @param dpr The device pixel ratio of the mask.
+     **/
+    static Method preferredMethod(int radius, qreal dpr);
+
     /**
      * Calculate the minimum size of the box.
      *
@@ -88,10 +199,26 @@ public:
      **/
     static QSize calculateMinimumShadowTextureSize(const QSize &boxSize, int radius, const QPoint &offset);
 
+    /**
+     * Calculate the size of the box for a nine-slice shadow texture.
+     *
+     * This helper computes the smallest box for which the center row and column of
+     * the shadow texture are not affected by the rounded corners anymore. The
+     * resulting texture only consists of the four unique corner tiles and a one
+     * pixel wide strip between them, which the compositor stretches along the
+     * window edges, so there is nothing redundant to render or to keep in memory.
+     *
+     * @param radius The blur radius of the shadow.
+     * @param offset The offset of the shadow.
+     * @param borderRadius The radius of box' corners, in pixels.
+     **/
+    static QSize calculateNineSliceBoxSize(int radius, const QPoint &offset, qreal borderRadius);
+
 private:
     QSize m_boxSize;
     qreal m_borderRadius = 0.0;
     qreal m_dpr = 1.0;
+    Method m_method = Method::BoxBlur;
 
     struct Shadow {
         QPoint offset;
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// own
+#include "breezeshadowcache.h"
+
+// Qt
+#include <QCoreApplication>
+#include <QHash>
+#include <QRunnable>
+
+// std
+#include <algorithm>
+
+namespace Breeze
+{
+
+namespace
+{
+
+class ShadowRenderTask : public QRunnable
+{
+public:
+    explicit ShadowRenderTask(const std::function<void()> &function)
+        : m_function(function)
+    {
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+
+} // anonymous namespace
+
+// Active and inactive presets of a few exceptions with their own corner radius
+// comfortably fit in here.
+static const int s_maxCachedShadows = 32;
+
+bool ShadowCacheKey::operator==(const ShadowCacheKey &other) const
+{
+    return size == other.size
+        && strength == other.strength
+        && color == other.color
+        && cornerRadius == other.cornerRadius
+        && smallSpacing == other.smallSpacing
+        && devicePixelRatio == other.devicePixelRatio
+        && placeholder == other.placeholder;
+}
+
+uint qHash(const ShadowCacheKey &key, uint seed)
+{
+    uint hash = seed;
+    hash = 31 * hash + ::qHash(key.size);
+    hash = 31 * hash + ::qHash(key.strength);
+    hash = 31 * hash + ::qHash(key.color.rgba());
+    hash = 31 * hash + ::qHash(key.cornerRadius);
+    hash = 31 * hash + ::qHash(key.smallSpacing);
+    hash = 31 * hash + ::qHash(key.devicePixelRatio);
+    hash = 31 * hash + ::qHash(key.placeholder);
+    return hash;
+}
+
+ShadowCache::ShadowCache()
+    : m_shadows(s_maxCachedShadows)
+{
+    // Shadows only need to be rendered in the background when the settings
+    // change, one at a time is plenty. The renderer parallelizes on its own.
+    m_threadPool.setMaxThreadCount(1);
+}
+
+ShadowCache::~ShadowCache()
+{
+    // Tasks run code of the decoration plugin and deliver to m_context.
+    m_threadPool.waitForDone();
+}
+
+ShadowCache &ShadowCache::self()
+{
+    static ShadowCache cache;
+    return cache;
+}
+
+ShadowCache::ShadowPtr ShadowCache::shadow(const ShadowCacheKey &key, const Factory &factory)
+{
+    if (const ShadowPtr cached = find(key)) {
+        return cached;
+    }
+
+    // A render of the same shadow that may still be running in the background
+    // finds it cached once it is done, and only notifies who waits for it.
+    return insert(key, factory());
+}
+
+ShadowCache::ShadowPtr ShadowCache::shadow(const ShadowCacheKey &key, const Factory &factory,
+                                           QObject *receiver, const std::function<void()> &ready)
+{
+    if (const ShadowPtr cached = find(key)) {
+        return cached;
+    }
+
+    const bool rendering = m_pending.contains(key);
+
+    // Every receiver is notified once, whatever it asked for last wins.
+    QVector<Request> &requests = m_pending[key];
+    auto request = std::find_if(requests.begin(), requests.end(), [receiver](const Request &request) {
+        return request.receiver == receiver;
+    });
+    if (request != requests.end()) {
+        request->ready = ready;
+    } else {
+        requests.append({receiver, ready});
+    }
+
+    if (rendering) {
+        return {};
+    }
+
+    // m_context outlives the pool, see ~ShadowCache, and posting to it is thread-safe.
+    QObject *context = &m_context;
+    const int generation = m_generation;
+    m_threadPool.start(new ShadowRenderTask([this, context, key, factory, generation]() {
+        const Texture texture = factory();
+        QMetaObject::invokeMethod(context, [this, key, texture, generation]() {
+            finish(key, texture, generation);
+        }, Qt::QueuedConnection);
+    }));
+
+    return {};
+}
+
+ShadowCache::ShadowPtr ShadowCache::find(const ShadowCacheKey &key)
+{
+    if (const ShadowPtr *cached = m_shadows.object(key)) {
+        return *cached;
+    }
+
+    // Evicted while decorations still use it, it is cached again rather than
+    // created a second time.
+    const ShadowPtr shadow = m_liveShadows.value(key).toStrongRef();
+    if (shadow) {
+        m_shadows.insert(key, new ShadowPtr(shadow));
+    }
+    return shadow;
+}
+
+ShadowCache::ShadowPtr ShadowCache::insert(const ShadowCacheKey &key, const Texture &texture)
+{
+    // decorations that use the cached shadow already keep sharing it
+    if (const ShadowPtr cached = find(key)) {
+        return cached;
+    }
+
+    auto shadow = ShadowPtr::create();
+    shadow->setPadding(texture.padding);
+    shadow->setInnerShadowRect(texture.innerShadowRect);
+    shadow->setShadow(texture.image);
+
+    m_shadows.insert(key, new ShadowPtr(shadow));
+
+    // forget the shadows nobody uses anymore, m_liveShadows only grows with new keys
+    for (auto it = m_liveShadows.begin(); it != m_liveShadows.end();) {
+        if (it.value().isNull()) {
+            it = m_liveShadows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_liveShadows.insert(key, shadow);
+
+    return shadow;
+}
+
+void ShadowCache::finish(const ShadowCacheKey &key, const Texture &texture, int generation)
+{
+    // rendered before the cache was cleared
+    if (generation != m_generation) {
+        return;
+    }
+
+    insert(key, texture);
+
+    const QVector<Request> requests = m_pending.take(key);
+    for (const Request &request : requests) {
+        if (request.receiver) {
+            request.ready();
+        }
+    }
+}
+
+void ShadowCache::clear()
+{
+    // Renders that haven't started are dropped, and the one that is running
+    // delivers into the next generation, which ignores it. Waiting for it would
+    // block the compositor.
+    m_threadPool.clear();
+    ++m_generation;
+    QCoreApplication::removePostedEvents(&m_context, QEvent::MetaCall);
+
+    m_pending.clear();
+    m_shadows.clear();
+}
+
+} // namespace Breeze
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+// own
+#include "breezecommon_export.h"
+
+// KDecoration
+#include <KDecoration2/DecorationShadow>
+
+// Qt
+#include <QCache>
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QMargins>
+#include <QObject>
+#include <QPointer>
+#include <QRect>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+// std
+#include <functional>
+
+namespace Breeze
+{
+
+/**
+ * Parameters that fully describe a decoration shadow texture.
+ **/
+struct BREEZECOMMON_EXPORT ShadowCacheKey
+{
+    int size = 0;                 ///< index of the shadow size preset
+    int strength = 0;             ///< shadow strength, 0 to 255
+    QColor color;                 ///< shadow color
+    int cornerRadius = 0;         ///< window corner radius, in units of small spacing
+    int smallSpacing = 0;         ///< small spacing of the decoration settings
+    qreal devicePixelRatio = 1.0; ///< device pixel ratio of the texture
+    bool placeholder = false;     ///< cheap low resolution stand-in for the shadow
+
+    bool operator==(const ShadowCacheKey &other) const;
+};
+
+BREEZECOMMON_EXPORT uint qHash(const ShadowCacheKey &key, uint seed = 0);
+
+/**
+ * Process wide cache of rendered decoration shadows.
+ *
+ * All decorations that share the same shadow parameters share the same
+ * DecorationShadow instance, so switching focus between windows never has to
+ * blur anything and the compositor can keep using the textures it already has.
+ * Shadows that are in use are never evicted, only the ones that are kept around
+ * for later count against the limit of the cache.
+ *
+ * Shadows are rendered on a worker thread owned by the cache, so that the
+ * compositor isn't blocked while they are blurred. In the meantime decorations
+ * show the shadow they had, or a cheap placeholder that is rendered right away
+ * when they have none yet.
+ *
+ * Must only be used from the main thread.
+ **/
+class BREEZECOMMON_EXPORT ShadowCache
+{
+public:
+    using ShadowPtr = QSharedPointer<KDecoration2::DecorationShadow>;
+
+    /**
+     * Everything a DecorationShadow is made of, which unlike the shadow itself
+     * can be created on any thread.
+     **/
+    struct Texture
+    {
+        QImage image;
+        QMargins padding;
+        QRect innerShadowRect;
+    };
+
+    using Factory = std::function<Texture()>;
+
+    /**
+     * Returns the instance of the singleton.
+     **/
+    static ShadowCache &self();
+
+    /**
+     * Returns the shadow for the given parameters, rendering it right away if
+     * it is not cached yet. Meant for placeholders that are cheap to render.
+     *
+     * @param key The shadow parameters.
+     * @param factory Renders the shadow texture on cache misses.
+     **/
+    ShadowPtr shadow(const ShadowCacheKey &key, const Factory &factory);
+
+    /**
+     * Returns the shadow for the given parameters, if it is cached already.
+     *
+     * Otherwise, @p factory is run on a worker thread and a null pointer is
+     * returned. Once the texture is ready, the shadow is created and cached on
+     * the main thread, and @p ready is called, unless @p receiver has been
+     * destroyed in the meantime. Concurrent requests for the same parameters
+     * share a single render, and @p receiver is only notified once, with the
+     * @p ready callback of its latest request.
+     *
+     * @param key The shadow parameters.
+     * @param factory Renders the shadow texture on cache misses, must be thread-safe.
+     * @param receiver Object whose lifetime limits the @p ready notification.
+     * @param ready Called when the shadow has been rendered.
+     **/
+    ShadowPtr shadow(const ShadowCacheKey &key, const Factory &factory,
+                     QObject *receiver, const std::function<void()> &ready);
+
+    /**
+     * Drop all cached shadows.
+     *
+     * Shadows that are being rendered are dropped as well, along with the
+     * notifications of who waits for them. Renders that haven't started are
+     * cancelled and the result of a running one is discarded, without waiting
+     * for it. Decorations still hold a reference to the shadows they use, so
+     * this only releases shadows that are not used anymore.
+     **/
+    void clear();
+
+private:
+    ShadowCache();
+    ~ShadowCache();
+
+    //* cached shadow, or one that decorations still use, null otherwise
+    ShadowPtr find(const ShadowCacheKey &key);
+
+    //* create and cache a shadow, unless it is cached already
+    ShadowPtr insert(const ShadowCacheKey &key, const Texture &texture);
+
+    //* store a shadow rendered on a worker thread and notify who waits for it
+    void finish(const ShadowCacheKey &key, const Texture &texture, int generation);
+
+    struct Request
+    {
+        QPointer<QObject> receiver;
+        std::function<void()> ready;
+    };
+
+    //* shadows that are kept around, in least recently used order
+    QCache<ShadowCacheKey, ShadowPtr> m_shadows;
+
+    //* every shadow handed out, so that the ones still in use survive eviction from m_shadows
+    QHash<ShadowCacheKey, QWeakPointer<KDecoration2::DecorationShadow>> m_liveShadows;
+
+    //* shadows that are being rendered, with who waits for them
+    QHash<ShadowCacheKey, QVector<Request>> m_pending;
+
+    //* bumped by clear, renders started before are discarded
+    int m_generation = 0;
+
+    //* lives on the main thread, finished renders are delivered through its event queue
+    QObject m_context;
+
+    //* renders shadows in the background, destroyed before anything its tasks use
+    QThreadPool m_threadPool;
+};
+
+} // namespace Breeze
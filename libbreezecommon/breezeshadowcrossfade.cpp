@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// own
+#include "breezeshadowcrossfade.h"
+
+// Qt
+#include <QVarLengthArray>
+#include <QtMath>
+
+// std
+#include <algorithm>
+
+namespace Breeze
+{
+
+/**
+ * Geometry of a nine-slice texture along one axis, in device pixels.
+ **/
+struct NineSliceAxis
+{
+    int before = 0; ///< pixels before the center pixel
+    int after = 0;  ///< pixels after the center pixel
+};
+
+/**
+ * Map every pixel of the common texture along one axis to the source texture.
+ *
+ * Both halves stay anchored to the outer edge of the shadow. Pixels the
+ * source does not reach are transparent (-1), pixels between its corners and
+ * the common center are the stretched center pixel.
+ *
+ * @param source Geometry of the source texture.
+ * @param beforeOffset Pixels the source starts after the start of the common texture.
+ * @param afterOffset Pixels the source ends before the end of the common texture.
+ * @param common Geometry of the common texture.
+ * @param map Receives the source index of every pixel of the common texture.
+ **/
+static void mapAxis(const NineSliceAxis &source, int beforeOffset, int afterOffset,
+                    const NineSliceAxis &common, int *map)
+{
+    const int size = common.before + 1 + common.after;
+    const int sourceSize = source.before + 1 + source.after;
+
+    for (int i = 0; i < size; ++i) {
+        int index;
+        if (i < common.before) {
+            index = i - beforeOffset;
+            index = index < 0 ? -1 : qMin(index, source.before);
+        } else if (i > common.before) {
+            const int distance = size - 1 - i - afterOffset;
+            index = distance < 0 ? -1 : qMax(sourceSize - 1 - distance, source.before);
+        } else {
+            index = source.before;
+        }
+        map[i] = index;
+    }
+}
+
+/**
+ * Lay out a shadow texture on the common geometry.
+ **/
+static QImage remap(const QImage &source, const int *columns, int width, const int *rows, int height)
+{
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(source.devicePixelRatio());
+
+    for (int y = 0; y < height; ++y) {
+        QRgb *out = reinterpret_cast<QRgb *>(image.scanLine(y));
+        if (rows[y] < 0) {
+            std::fill(out, out + width, 0);
+            continue;
+        }
+
+        const QRgb *in = reinterpret_cast<const QRgb *>(source.constScanLine(rows[y]));
+        for (int x = 0; x < width; ++x) {
+            out[x] = columns[x] < 0 ? 0 : in[columns[x]];
+        }
+    }
+
+    return image;
+}
+
+ShadowCrossFade::ShadowCrossFade(const QSharedPointer<KDecoration2::DecorationShadow> &from,
+                                 const QSharedPointer<KDecoration2::DecorationShadow> &to)
+{
+    const QImage fromImage = from->shadow().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QImage toImage = to->shadow().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    const qreal dpr = fromImage.devicePixelRatio();
+    if (fromImage.isNull() || toImage.isNull() || !qFuzzyCompare(dpr, toImage.devicePixelRatio())
+        || from->innerShadowRect().size() != QSize(1, 1) || to->innerShadowRect().size() != QSize(1, 1)) {
+        return;
+    }
+
+    // padding is in logical pixels, the textures in device pixels
+    const QMargins fromPadding = from->padding();
+    const QMargins toPadding = to->padding();
+    m_padding = QMargins(qMax(fromPadding.left(), toPadding.left()),
+                         qMax(fromPadding.top(), toPadding.top()),
+                         qMax(fromPadding.right(), toPadding.right()),
+                         qMax(fromPadding.bottom(), toPadding.bottom()));
+
+    const auto offset = [dpr](int common, int own) {
+        return qRound((common - own) * dpr);
+    };
+
+    const QRect fromInner = from->innerShadowRect();
+    const QRect toInner = to->innerShadowRect();
+
+    const NineSliceAxis fromX{fromInner.left(), fromImage.width() - fromInner.left() - 1};
+    const NineSliceAxis fromY{fromInner.top(), fromImage.height() - fromInner.top() - 1};
+    const NineSliceAxis toX{toInner.left(), toImage.width() - toInner.left() - 1};
+    const NineSliceAxis toY{toInner.top(), toImage.height() - toInner.top() - 1};
+
+    const int fromLeft = offset(m_padding.left(), fromPadding.left());
+    const int fromTop = offset(m_padding.top(), fromPadding.top());
+    const int fromRight = offset(m_padding.right(), fromPadding.right());
+    const int fromBottom = offset(m_padding.bottom(), fromPadding.bottom());
+    const int toLeft = offset(m_padding.left(), toPadding.left());
+    const int toTop = offset(m_padding.top(), toPadding.top());
+    const int toRight = offset(m_padding.right(), toPadding.right());
+    const int toBottom = offset(m_padding.bottom(), toPadding.bottom());
+
+    const NineSliceAxis commonX{qMax(fromLeft + fromX.before, toLeft + toX.before),
+                                qMax(fromRight + fromX.after, toRight + toX.after)};
+    const NineSliceAxis commonY{qMax(fromTop + fromY.before, toTop + toY.before),
+                                qMax(fromBottom + fromY.after, toBottom + toY.after)};
+
+    const int width = commonX.before + 1 + commonX.after;
+    const int height = commonY.before + 1 + commonY.after;
+
+    QVarLengthArray<int, 512> columns(width);
+    QVarLengthArray<int, 512> rows(height);
+
+    mapAxis(fromX, fromLeft, fromRight, commonX, columns.data());
+    mapAxis(fromY, fromTop, fromBottom, commonY, rows.data());
+    m_from = remap(fromImage, columns.constData(), width, rows.constData(), height);
+
+    mapAxis(toX, toLeft, toRight, commonX, columns.data());
+    mapAxis(toY, toTop, toBottom, commonY, rows.data());
+    m_to = remap(toImage, columns.constData(), width, rows.constData(), height);
+
+    m_innerShadowRect = QRect(commonX.before, commonY.before, 1, 1);
+
+    for (QImage &frame : m_frames) {
+        frame = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+        frame.setDevicePixelRatio(dpr);
+    }
+}
+
+bool ShadowCrossFade::isValid() const
+{
+    return !m_from.isNull();
+}
+
+QMargins ShadowCrossFade::padding() const
+{
+    return m_padding;
+}
+
+QRect ShadowCrossFade::innerShadowRect() const
+{
+    return m_innerShadowRect;
+}
+
+QImage ShadowCrossFade::frame(qreal progress)
+{
+    m_currentFrame ^= 1;
+    QImage &frame = m_frames[m_currentFrame];
+
+    // Whatever holds on to the frame handed out from this buffer, writing to it
+    // would copy every pixel first, which are all overwritten anyway.
+    if (!frame.isDetached()) {
+        const qreal dpr = frame.devicePixelRatio();
+        frame = QImage(frame.size(), QImage::Format_ARGB32_Premultiplied);
+        frame.setDevicePixelRatio(dpr);
+    }
+
+    // premultiplied channels blend linearly, weights are in 1/256 steps
+    const int weight = qBound(0, qRound(progress * 256), 256);
+    const int inverseWeight = 256 - weight;
+
+    // scanlines of 32 bit images are never padded
+    const qsizetype count = m_from.sizeInBytes();
+    const uchar *from = m_from.constBits();
+    const uchar *to = m_to.constBits();
+    uchar *out = frame.bits();
+
+    for (qsizetype i = 0; i < count; ++i) {
+        out[i] = static_cast<uchar>((from[i] * inverseWeight + to[i] * weight + 128) >> 8);
+    }
+
+    return frame;
+}
+
+} // namespace Breeze
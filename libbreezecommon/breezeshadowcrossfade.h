@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+// own
+#include "breezecommon_export.h"
+
+// KDecoration
+#include <KDecoration2/DecorationShadow>
+
+// Qt
+#include <QImage>
+#include <QMargins>
+#include <QRect>
+#include <QSharedPointer>
+
+namespace Breeze
+{
+
+/**
+ * Cross-fade between two decoration shadows.
+ *
+ * The shadows may use different presets, so both textures are laid out once
+ * on a common nine-slice geometry that is large enough for either of them.
+ * Every frame of the transition is then a linear blend of the two, which is
+ * far cheaper than rendering an intermediate shadow.
+ **/
+class BREEZECOMMON_EXPORT ShadowCrossFade
+{
+public:
+    /**
+     * @param from The shadow the transition starts from.
+     * @param to The shadow the transition ends with.
+     **/
+    ShadowCrossFade(const QSharedPointer<KDecoration2::DecorationShadow> &from,
+                    const QSharedPointer<KDecoration2::DecorationShadow> &to);
+
+    /**
+     * Returns whether both shadows could be put on a common geometry.
+     *
+     * Transitions between textures of different device pixel ratios, or
+     * between textures that are not one pixel wide nine-slices, are not supported.
+     **/
+    bool isValid() const;
+
+    /**
+     * Padding of the blended texture.
+     **/
+    QMargins padding() const;
+
+    /**
+     * Inner shadow rect of the blended texture.
+     **/
+    QRect innerShadowRect() const;
+
+    /**
+     * Blend both shadows.
+     *
+     * Frames alternate between two buffers, so that the frame that is still
+     * shown is never overwritten. The returned image shares its buffer, which
+     * is only reused two frames later if nobody holds on to it anymore. Otherwise
+     * a new buffer is allocated for it, rather than detaching and copying it.
+     *
+     * @param progress The progress of the transition, from 0 to 1.
+     * @returns The blended texture.
+     **/
+    QImage frame(qreal progress);
+
+private:
+    QImage m_from;
+    QImage m_to;
+    QImage m_frames[2];
+    int m_currentFrame = 0;
+
+    QMargins m_padding;
+    QRect m_innerShadowRect;
+};
+
+} // namespace Breeze
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// own
+#include "breezeshadowdiskcache.h"
+#include "config-breezecommon.h"
+
+// Qt
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// std
+#include <cstring>
+#include <mutex>
+
+namespace Breeze
+{
+
+namespace ShadowDiskCache
+{
+
+// Bump whenever the way masks are generated changes without a version change
+// of the library, so that stale masks are not loaded anymore.
+static const int s_maskFormatVersion = 2;
+
+static const char s_magic[8] = {'B', 'R', 'Z', 'M', 'A', 'S', 'K', '1'};
+
+// Followed by the rows of the mask. Its size keeps the rows aligned.
+struct Header
+{
+    char magic[8];
+    quint32 width;
+    quint32 height;
+    quint32 bytesPerLine;
+    quint32 reserved[3];
+};
+
+// Upper bound for the masks kept on disk, in bytes. The masks of all presets
+// at a couple of device pixel ratios take a few megabytes.
+static const qint64 s_maxCacheBytes = 32 * 1024 * 1024;
+
+static QString baseDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + QStringLiteral("/mkossierrabreeze/shadows");
+}
+
+static QString versionName()
+{
+    return QStringLiteral(BREEZE_COMMON_VERSION "-") + QString::number(s_maskFormatVersion);
+}
+
+static QString directory()
+{
+    return baseDirectory() + QLatin1Char('/') + versionName();
+}
+
+static QString fileName(const QByteArray &key)
+{
+    const QByteArray hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1);
+    return directory() + QLatin1Char('/') + QString::fromLatin1(hash.toHex()) + QStringLiteral(".mask");
+}
+
+/**
+ * Remove the masks of other versions, and the oldest masks past the size limit.
+ **/
+static void sweep()
+{
+    QDir base(baseDirectory());
+    const QStringList versions = base.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &version : versions) {
+        if (version != versionName()) {
+            QDir(base.filePath(version)).removeRecursively();
+        }
+    }
+
+    // Masks are never modified, so the newest ones are the ones of the current settings.
+    const QFileInfoList masks = QDir(directory()).entryInfoList({QStringLiteral("*.mask")}, QDir::Files, QDir::Time);
+    qint64 size = 0;
+    for (const QFileInfo &mask : masks) {
+        size += mask.size();
+        if (size > s_maxCacheBytes) {
+            QFile::remove(mask.filePath());
+        }
+    }
+}
+
+static void unmapFile(void *file)
+{
+    // Closing the file releases the mapping.
+    delete static_cast<QFile *>(file);
+}
+
+QImage load(const QByteArray &key, const QSize &size, qreal dpr)
+{
+    QFile *file = new QFile(fileName(key));
+    if (!file->open(QIODevice::ReadOnly) || file->size() < qint64(sizeof(Header))) {
+        delete file;
+        return {};
+    }
+
+    // Private mapping, so that modifying the image copies pages instead of writing to the file.
+    uchar *data = file->map(0, file->size(), QFileDevice::MapPrivateOption);
+    if (!data) {
+        delete file;
+        return {};
+    }
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+
+    // Anything else in the header would have the image read past the mapping
+    // or show a mask of another size than the one asked for.
+    const qint64 dataSize = qint64(header.bytesPerLine) * header.height;
+    if (std::memcmp(header.magic, s_magic, sizeof(s_magic)) != 0
+        || qint64(header.width) != size.width()
+        || qint64(header.height) != size.height()
+        || header.bytesPerLine < header.width
+        || header.bytesPerLine % 4 != 0
+        || header.bytesPerLine - header.width > 3
+        || file->size() != qint64(sizeof(Header)) + dataSize) {
+        delete file;
+        return {};
+    }
+
+    QImage mask(data + sizeof(Header), header.width, header.height, header.bytesPerLine,
+                QImage::Format_Alpha8, unmapFile, file);
+    mask.setDevicePixelRatio(dpr);
+    return mask;
+}
+
+void store(const QByteArray &key, const QImage &mask)
+{
+    if (mask.format() != QImage::Format_Alpha8) {
+        return;
+    }
+
+    // Stores are rare, they only happen when masks have not been found on disk.
+    static std::once_flag swept;
+    std::call_once(swept, sweep);
+
+    if (!QDir().mkpath(directory())) {
+        return;
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.width = mask.width();
+    header.height = mask.height();
+    header.bytesPerLine = mask.bytesPerLine();
+
+    // Written to a temporary file and renamed, so readers never see half a mask.
+    QSaveFile file(fileName(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(mask.constBits()), qint64(header.bytesPerLine) * header.height);
+    file.commit();
+}
+
+} // namespace ShadowDiskCache
+
+} // namespace Breeze
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+// This header is private to libbreezecommon.
+
+// Qt
+#include <QByteArray>
+#include <QImage>
+#include <QSize>
+
+namespace Breeze
+{
+
+/**
+ * Shadow masks persisted in $XDG_CACHE_HOME.
+ *
+ * KWin renders the same few shadows after every start and every reload of the
+ * decoration plugin. Keeping their masks on disk turns that into mapping a
+ * small file. Files are named after a hash of the mask parameters, in a
+ * directory named after the version of the library, so masks of other
+ * versions are never picked up. The first store of a process removes the
+ * directories of other versions, and the oldest masks past a size limit.
+ *
+ * Both functions are thread-safe.
+ **/
+namespace ShadowDiskCache
+{
+
+/**
+ * Load a mask stored under the given key.
+ *
+ * The file is memory mapped, the returned image uses the mapping until it is
+ * modified or destroyed. Files whose header doesn't match @p size or the
+ * length of the file are ignored.
+ *
+ * @param key Unique description of the mask parameters.
+ * @param size The size of the mask the key describes, in device pixels.
+ * @param dpr The device pixel ratio of the mask.
+ * @returns The Format_Alpha8 mask, or a null image if there is none.
+ **/
+QImage load(const QByteArray &key, const QSize &size, qreal dpr);
+
+/**
+ * Store a mask under the given key, replacing whatever was stored before.
+ *
+ * @param key Unique description of the mask parameters.
+ * @param mask The Format_Alpha8 mask.
+ **/
+void store(const QByteArray &key, const QImage &mask);
+
+} // namespace ShadowDiskCache
+
+} // namespace Breeze
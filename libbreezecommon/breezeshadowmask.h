@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+// This header is private to libbreezecommon, it is only exported for the
+// autotests and benchmarks.
+
+// own
+#include "breezeboxblurkernel.h"
+#include "breezeboxshadowrenderer.h"
+#include "breezecommon_export.h"
+
+// Qt
+#include <QImage>
+#include <QRect>
+#include <QSize>
+
+namespace Breeze
+{
+
+/**
+ * Stages of rendering the alpha mask of a shadow, without any caching.
+ **/
+namespace ShadowMask
+{
+
+/**
+ * Render the blurred alpha mask of a shadow, as BoxShadowRenderer::renderMask
+ * does when the mask is neither cached in memory nor on disk.
+ *
+ * @param boxSize The size of the box.
+ * @param borderRadius The radius of box' corners.
+ * @param radius The blur radius.
+ * @param dpr The device pixel ratio of the mask.
+ * @param method The method used to generate the mask.
+ **/
+BREEZECOMMON_EXPORT QImage generate(const QSize &boxSize, qreal borderRadius, int radius, qreal dpr,
+                                    BoxShadowRenderer::Method method);
+
+/**
+ * Render the blurred alpha mask of a shadow from the mask of a smaller radius
+ * around the same box, as BoxShadowRenderer::renderMasks does for the larger
+ * radii of a shadow.
+ *
+ * @param source The box blurred mask of the smaller radius.
+ * @param sourceRadius The blur radius of @p source.
+ * @param boxSize The size of the box.
+ * @param borderRadius The radius of box' corners.
+ * @param radius The blur radius.
+ * @param dpr The device pixel ratio of both masks.
+ * @param method The method used to generate the mask.
+ * @returns The mask, or a null image if it can't continue from @p source, for
+ *    example because the analytic method is used or the masks don't line up on
+ *    whole device pixels.
+ **/
+BREEZECOMMON_EXPORT QImage generateFrom(const QImage &source, int sourceRadius, const QSize &boxSize,
+                                        qreal borderRadius, int radius, qreal dpr, BoxShadowRenderer::Method method);
+
+/**
+ * How the vertical pass of boxBlur walks the columns of an image.
+ **/
+enum class VerticalPass {
+    /**
+     * Blur the columns in place, what the renderer does.
+     **/
+    Direct,
+
+    /**
+     * Pack strips of columns into a compact tile first, and blur the tile.
+     * Only kept to measure it against the direct pass, it is slower for masks.
+     **/
+    Tiled
+};
+
+/**
+ * Blur the alpha channel of an image with three box filters.
+ *
+ * @param image An 8-bit alpha mask or a 32-bit ARGB image.
+ * @param radius The blur radius.
+ * @param rect Specifies what part of the image to blur, the whole image if null.
+ * @param verticalPass How the columns are blurred, the result is the same.
+ **/
+BREEZECOMMON_EXPORT void boxBlur(QImage &image, int radius, const QRect &rect = {},
+                                 VerticalPass verticalPass = VerticalPass::Direct);
+
+/**
+ * Process a row with a box filter, one alpha value at a time.
+ *
+ * This is the scalar path of boxBlur, the vector kernels must match it byte for byte.
+ *
+ * @param src The first alpha value of the row.
+ * @param srcStep The number of bytes from one input alpha value to the next.
+ * @param dst The destination, must not overlap @p src.
+ * @param dstStep The number of bytes from one output alpha value to the next.
+ * @param length The number of alpha values, at least the size of the box.
+ * @param lobes Params of the box filter.
+ **/
+BREEZECOMMON_EXPORT void boxBlurRow(const uint8_t *src, int srcStep, uint8_t *dst, int dstStep, int length,
+                                    const BoxLobes &lobes);
+
+/**
+ * Extend the blurred corner of the top-left quadrant to the whole quadrant.
+ *
+ * @param image An 8-bit alpha mask or a 32-bit ARGB image.
+ * @param corner Size of the corner that has been blurred already.
+ * @param quadrant Size of the top-left quadrant.
+ **/
+BREEZECOMMON_EXPORT void extendCorner(QImage &image, const QSize &corner, const QSize &quadrant);
+
+/**
+ * Mirror the top-left quadrant of the alpha channel to the other three.
+ *
+ * @param image An 8-bit alpha mask or a 32-bit ARGB image.
+ **/
+BREEZECOMMON_EXPORT void mirrorTopLeftQuadrant(QImage &image);
+
+} // namespace ShadowMask
+
+} // namespace Breeze
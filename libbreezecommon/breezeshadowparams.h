@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2023 Paulo Otávio de Lima (aka Aragubas) <dpaulootavio5@outlook.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+// own
+#include "breezeboxshadowrenderer.h"
+
+// Qt
+#include <QPoint>
+#include <QSize>
+
+namespace Breeze
+{
+
+/**
+ * Parameters of a single shadow.
+ **/
+struct ShadowParams
+{
+    ShadowParams()
+        : offset(QPoint(0, 0))
+        , radius(0)
+        , opacity(0)
+    {
+    }
+
+    ShadowParams(const QPoint &offset, int radius, qreal opacity)
+        : offset(offset)
+        , radius(radius)
+        , opacity(opacity)
+    {
+    }
+
+    QPoint offset;
+    int radius;
+    qreal opacity;
+};
+
+/**
+ * Parameters of a decoration shadow, made of two layered shadows.
+ **/
+struct CompositeShadowParams
+{
+    CompositeShadowParams() = default;
+
+    CompositeShadowParams(const QPoint &offset, const ShadowParams &shadow1, const ShadowParams &shadow2)
+        : offset(offset)
+        , shadow1(shadow1)
+        , shadow2(shadow2)
+    {
+    }
+
+    bool isNone() const
+    {
+        return qMax(shadow1.radius, shadow2.radius) == 0;
+    }
+
+    /**
+     * Returns the size of the box of the nine-slice shadow texture.
+     *
+     * The compositor stretches the center strip along the window edges, so the
+     * box only needs to be large enough to keep all four corners unique.
+     *
+     * @param borderRadius The radius of the window corners, in pixels.
+     **/
+    QSize boxSize(qreal borderRadius) const
+    {
+        return BoxShadowRenderer::calculateNineSliceBoxSize(shadow1.radius, shadow1.offset, borderRadius)
+            .expandedTo(BoxShadowRenderer::calculateNineSliceBoxSize(shadow2.radius, shadow2.offset, borderRadius));
+    }
+
+    QPoint offset;
+    ShadowParams shadow1;
+    ShadowParams shadow2;
+};
+
+/**
+ * Shadow size presets, shared by the decoration, its autotests and benchmarks.
+ **/
+static const CompositeShadowParams s_shadowParams[] = {
+    // None
+    CompositeShadowParams(),
+    // Small
+    CompositeShadowParams(
+        QPoint(0, 4),
+        ShadowParams(QPoint(0, 0), 16, 1),
+        ShadowParams(QPoint(0, -2), 8, 0.4)),
+    // Medium
+    CompositeShadowParams(
+        QPoint(0, 8),
+        ShadowParams(QPoint(0, 0), 32, 0.9),
+        ShadowParams(QPoint(0, -4), 16, 0.3)),
+    // Large
+    CompositeShadowParams(
+        QPoint(0, 12),
+        ShadowParams(QPoint(0, 0), 48, 0.8),
+        ShadowParams(QPoint(0, -6), 24, 0.2)),
+    // Very large
+    CompositeShadowParams(
+        QPoint(0, 16),
+        ShadowParams(QPoint(0, 0), 64, 0.7),
+        ShadowParams(QPoint(0, -8), 32, 0.1))
+};
+
+static const int s_shadowParamsCount = sizeof(s_shadowParams) / sizeof(s_shadowParams[0]);
+
+} // namespace Breeze
@@ -25,4 +25,10 @@
 /* Define to 1 if breeze is compiled against KDE4 */
 #cmakedefine01 BREEZE_COMMON_USE_KDE4
 
+/* Define to 1 if the AVX2 box blur kernel is built */
+#cmakedefine01 BREEZE_COMMON_HAVE_AVX2
+
+/* Version of the library, cached shadows of other versions are ignored */
+#define BREEZE_COMMON_VERSION "${PROJECT_VERSION}"
+
 #endif